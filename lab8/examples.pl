@@ -3,16 +3,20 @@
 # EECS678
 # Adopted from CS 241 @ The University of Illinois
 
+# Each example is checked in the default tick-by-tick mode and again in
+# event-driven mode (-e), which must produce the same final results.
+for $mode ("", "-e"){
 for $file (<examples/*>){
 	if( $file =~ /proc(\d+)-c(\d+)-(\w+)\.out/){
 	#	print "Proc $1 CORE $2 Proc $3\n";
-		`./simulator -c $2 -s $3 examples/proc$1.csv | tail -7 > output1`;
+		`./simulator $mode -c $2 -s $3 examples/proc$1.csv | tail -7 > output1`;
 		`tail -7 $file > output2`;
 		$diff = `diff output1 output2`;
 		if($diff){
-			print "Test file $file differs\n$diff";
+			print "Test file $file differs" . ($mode ? " ($mode)" : "") . "\n$diff";
 		}
 	}
 }
+}
 #cleanup
 `rm output1 output2`;
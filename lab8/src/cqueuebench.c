@@ -0,0 +1,110 @@
+/** @file cqueuebench.c
+ *
+ * Scaling benchmark for cpriqueue_t. Each thread alternates offer and poll
+ * on a shared, pre-filled queue. Every thread count is run twice: once with
+ * a single shard (one global lock, exact order) and once with two shards
+ * per thread. Thread counts double from 1 and end at max threads.
+ *
+ * Usage: ./cqueuebench [max threads] [ops per thread]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libpriqueue/libcpriqueue.h"
+
+#define PREFILL 100000
+
+typedef struct
+{
+	cpriqueue_t *q;
+	int *keys;
+	int ops;
+} worker_arg_t;
+
+int compare_int(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void *worker(void *arg)
+{
+	worker_arg_t *w = (worker_arg_t *)arg;
+	int i;
+
+	for (i = 0; i < w->ops; i++)
+	{
+		cpriqueue_offer(w->q, &w->keys[i]);
+		cpriqueue_poll(w->q);
+	}
+	return NULL;
+}
+
+void bench(int threads, int shards, int ops, int *keys)
+{
+	cpriqueue_t q;
+	pthread_t tids[threads];
+	worker_arg_t args[threads];
+	int i;
+
+	cpriqueue_init(&q, compare_int, shards);
+	for (i = 0; i < PREFILL; i++)
+		cpriqueue_offer(&q, &keys[i % ops]);
+
+	double start = now_ns();
+	for (i = 0; i < threads; i++)
+	{
+		args[i] = (worker_arg_t){ .q = &q, .keys = keys, .ops = ops };
+		pthread_create(&tids[i], NULL, worker, &args[i]);
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	double elapsed = now_ns() - start;
+
+	printf("threads %3d  shards %3d  %8.2f Mops/s  (size %d, expected %d)\n",
+			threads, shards, 2.0 * threads * ops / elapsed * 1e3, cpriqueue_size(&q), PREFILL);
+
+	cpriqueue_destroy(&q);
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int ops = argc > 2 ? atoi(argv[2]) : 200000;
+	int threads, i;
+
+	if (max_threads < 1)
+		max_threads = 1;
+	if (ops < 1)
+	{
+		fprintf(stderr, "Usage: %s [max threads] [ops per thread]\nops per thread must be positive\n", argv[0]);
+		return 1;
+	}
+
+	int *keys = malloc(ops * sizeof(int));
+	srand(678);
+	for (i = 0; i < ops; i++)
+		keys[i] = rand();
+
+	for (threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+	{
+		bench(threads, 1, ops, keys);
+		bench(threads, 2 * threads, ops, keys);
+		if (threads == max_threads)
+			break;
+	}
+
+	free(keys);
+	return 0;
+}
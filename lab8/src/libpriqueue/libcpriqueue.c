@@ -0,0 +1,317 @@
+/** @file libcpriqueue.c
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "libcpriqueue.h"
+
+/*
+  Per-thread xorshift state for shard selection, so picking a shard never
+  touches shared memory.
+ */
+static __thread uint32_t shard_seed = 0;
+
+static int random_shard(cpriqueue_t *q)
+{
+  if (shard_seed == 0)
+    shard_seed = (uint32_t)(uintptr_t)&shard_seed ^ (uint32_t)time(NULL) ^ 0x9e3779b9u;
+
+  shard_seed ^= shard_seed << 13;
+  shard_seed ^= shard_seed >> 17;
+  shard_seed ^= shard_seed << 5;
+  return shard_seed % q->num_shards;
+}
+
+static void lock_all(cpriqueue_t *q)
+{
+  for (int i = 0; i < q->num_shards; i++)
+    pthread_mutex_lock(&q->shards[i].lock);
+}
+
+static void unlock_all(cpriqueue_t *q)
+{
+  for (int i = q->num_shards - 1; i >= 0; i--)
+    pthread_mutex_unlock(&q->shards[i].lock);
+}
+
+/*
+  Returns the shard whose next element in a k-way merge of all shards comes
+  first, given how many elements have already been taken from each shard.
+  All shards must be locked.
+ */
+static int merge_next(cpriqueue_t *q, int *taken)
+{
+  int best = -1;
+  void *best_data = NULL;
+
+  for (int i = 0; i < q->num_shards; i++)
+  {
+    void *data = priqueue_at(&q->shards[i].queue, taken[i]);
+    if (data != NULL && (best == -1 || q->comparer(data, best_data) < 0))
+    {
+      best = i;
+      best_data = data;
+    }
+  }
+  return best;
+}
+
+/*
+  Finds the shard and in-shard position of the index'th element overall.
+  All shards must be locked.
+ */
+static int locate(cpriqueue_t *q, int index, int *position)
+{
+  int *taken = (int *)calloc(q->num_shards, sizeof(int));
+  int shard = -1;
+
+  for (int i = 0; i <= index; i++)
+  {
+    shard = merge_next(q, taken);
+    if (shard == -1)
+      break;
+    taken[shard]++;
+  }
+
+  if (shard != -1)
+    *position = taken[shard] - 1;
+  free(taken);
+  return shard;
+}
+
+/**
+  Initializes the cpriqueue_t data structure.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param shards number of independently locked heaps; use about twice the
+  number of threads, or 1 for exact ordering
+ */
+void cpriqueue_init(cpriqueue_t *q, int (*comparer)(const void *, const void *), int shards)
+{
+  if (shards < 1)
+    shards = 1;
+
+  q->shards = (cpriqueue_shard_t *)aligned_alloc(CPRIQUEUE_CACHE_LINE, shards * sizeof(cpriqueue_shard_t));
+  q->num_shards = shards;
+  q->size = 0;
+  q->comparer = comparer;
+
+  for (int i = 0; i < shards; i++)
+  {
+    pthread_mutex_init(&q->shards[i].lock, NULL);
+    priqueue_init_backend(&q->shards[i].queue, comparer, PRIQUEUE_HEAP);
+  }
+}
+
+/**
+  Insert the specified element into a randomly chosen shard.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @return the zero-based slot of ptr within its shard
+ */
+int cpriqueue_offer(cpriqueue_t *q, void *ptr)
+{
+  cpriqueue_shard_t *shard = &q->shards[random_shard(q)];
+
+  // Prefer an uncontended shard, but do not spin forever looking for one.
+  for (int tries = 0; tries < 4; tries++)
+  {
+    if (pthread_mutex_trylock(&shard->lock) == 0)
+      goto locked;
+    shard = &q->shards[random_shard(q)];
+  }
+  pthread_mutex_lock(&shard->lock);
+
+locked:;
+  int index = priqueue_offer(&shard->queue, ptr);
+  __atomic_add_fetch(&q->size, 1, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&shard->lock);
+  return index;
+}
+
+/**
+  Retrieves, but does not remove, the best head across all shards.
+
+  The result is a snapshot; another thread may poll it immediately after.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return pointer to element at the head of the queue
+  @return NULL if the queue is empty
+ */
+void *cpriqueue_peek(cpriqueue_t *q)
+{
+  void *best = NULL;
+
+  for (int i = 0; i < q->num_shards; i++)
+  {
+    pthread_mutex_lock(&q->shards[i].lock);
+    void *data = priqueue_peek(&q->shards[i].queue);
+    if (data != NULL && (best == NULL || q->comparer(data, best) < 0))
+      best = data;
+    pthread_mutex_unlock(&q->shards[i].lock);
+  }
+  return best;
+}
+
+/**
+  Retrieves and removes the better head of two randomly chosen shards,
+  falling back to a scan of every shard when both are empty.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return an element at or near the head of this queue
+  @return NULL if this queue is empty
+ */
+void *cpriqueue_poll(cpriqueue_t *q)
+{
+  void *data = NULL;
+
+  if (q->num_shards > 1)
+  {
+    int a = random_shard(q), b = random_shard(q);
+    if (a == b)
+      b = (a + 1) % q->num_shards;
+    if (a > b)
+    {
+      int tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+    // Always lock the lower shard first so two pollers cannot deadlock.
+    pthread_mutex_lock(&q->shards[a].lock);
+    pthread_mutex_lock(&q->shards[b].lock);
+
+    void *head_a = priqueue_peek(&q->shards[a].queue);
+    void *head_b = priqueue_peek(&q->shards[b].queue);
+    if (head_a != NULL && (head_b == NULL || q->comparer(head_a, head_b) <= 0))
+      data = priqueue_poll(&q->shards[a].queue);
+    else if (head_b != NULL)
+      data = priqueue_poll(&q->shards[b].queue);
+
+    pthread_mutex_unlock(&q->shards[b].lock);
+    pthread_mutex_unlock(&q->shards[a].lock);
+  }
+
+  for (int i = 0; data == NULL && i < q->num_shards; i++)
+  {
+    pthread_mutex_lock(&q->shards[i].lock);
+    data = priqueue_poll(&q->shards[i].queue);
+    pthread_mutex_unlock(&q->shards[i].lock);
+  }
+
+  if (data != NULL)
+    __atomic_sub_fetch(&q->size, 1, __ATOMIC_RELAXED);
+  return data;
+}
+
+/**
+  Returns the element at the specified position in the exact order across
+  all shards. Every shard is locked for the duration of the call.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param index position of retrieved element
+  @return the index'th element in the queue
+  @return NULL if the queue does not contain the index'th element
+ */
+void *cpriqueue_at(cpriqueue_t *q, int index)
+{
+  if (index < 0)
+    return NULL;
+
+  void *data = NULL;
+  int position;
+
+  lock_all(q);
+  int shard = locate(q, index, &position);
+  if (shard != -1)
+    data = priqueue_at(&q->shards[shard].queue, position);
+  unlock_all(q);
+
+  return data;
+}
+
+/**
+  Removes all instances of ptr from every shard.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param ptr address of element to be removed
+  @return the number of entries removed
+ */
+int cpriqueue_remove(cpriqueue_t *q, void *ptr)
+{
+  int count = 0;
+
+  for (int i = 0; i < q->num_shards; i++)
+  {
+    pthread_mutex_lock(&q->shards[i].lock);
+    count += priqueue_remove(&q->shards[i].queue, ptr);
+    pthread_mutex_unlock(&q->shards[i].lock);
+  }
+
+  __atomic_sub_fetch(&q->size, count, __ATOMIC_RELAXED);
+  return count;
+}
+
+/**
+  Removes the element at the specified position in the exact order across
+  all shards. Every shard is locked for the duration of the call.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @param index position of element to be removed
+  @return the element removed from the queue
+  @return NULL if the specified index does not exist
+ */
+void *cpriqueue_remove_at(cpriqueue_t *q, int index)
+{
+  if (index < 0)
+    return NULL;
+
+  void *data = NULL;
+  int position;
+
+  lock_all(q);
+  int shard = locate(q, index, &position);
+  if (shard != -1)
+  {
+    data = priqueue_remove_at(&q->shards[shard].queue, position);
+    __atomic_sub_fetch(&q->size, 1, __ATOMIC_RELAXED);
+  }
+  unlock_all(q);
+
+  return data;
+}
+
+/**
+  Return the number of elements in the queue. Under concurrent use this is
+  a snapshot.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+  @return the number of elements in the queue
+ */
+int cpriqueue_size(cpriqueue_t *q)
+{
+  return __atomic_load_n(&q->size, __ATOMIC_RELAXED);
+}
+
+/**
+  Destroys and frees all the memory associated with q. No other thread may
+  be using q.
+
+  @param q a pointer to an instance of the cpriqueue_t data structure
+ */
+void cpriqueue_destroy(cpriqueue_t *q)
+{
+  for (int i = 0; i < q->num_shards; i++)
+  {
+    priqueue_destroy(&q->shards[i].queue);
+    pthread_mutex_destroy(&q->shards[i].lock);
+  }
+  free(q->shards);
+  q->shards = NULL;
+  q->num_shards = 0;
+  q->size = 0;
+}
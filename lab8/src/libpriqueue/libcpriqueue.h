@@ -0,0 +1,55 @@
+/** @file libcpriqueue.h
+ */
+
+#ifndef LIBCPRIQUEUE_H_
+#define LIBCPRIQUEUE_H_
+
+#include <pthread.h>
+
+#include "libpriqueue.h"
+
+/**
+  Size of a cache line, assumed to be 64 bytes.
+*/
+#define CPRIQUEUE_CACHE_LINE 64
+
+/**
+  One lock-protected heap of a sharded queue. Aligned to a cache line, which
+  also rounds its size up to whole lines, so no two shards share a line and
+  threads working on neighbouring shards do not false-share.
+*/
+typedef struct
+{
+  _Alignas(CPRIQUEUE_CACHE_LINE) pthread_mutex_t lock;
+  priqueue_t queue;
+} cpriqueue_shard_t;
+
+/**
+  Thread-safe Priqueue Data Structure
+
+  A MultiQueue: elements are spread over several independently locked
+  heaps. Offer picks a random shard, poll takes the better head of two
+  random shards. With more than one shard, poll returns an element close to
+  the front rather than the exact front; with one shard the order is exact.
+*/
+typedef struct
+{
+  cpriqueue_shard_t *shards;
+  int num_shards;
+  int size;
+  int (*comparer)(const void *, const void *);
+} cpriqueue_t;
+
+void   cpriqueue_init     (cpriqueue_t *q, int(*comparer)(const void *, const void *), int shards);
+
+int    cpriqueue_offer    (cpriqueue_t *q, void *ptr);
+void * cpriqueue_peek     (cpriqueue_t *q);
+void * cpriqueue_poll     (cpriqueue_t *q);
+void * cpriqueue_at       (cpriqueue_t *q, int index);
+int    cpriqueue_remove   (cpriqueue_t *q, void *ptr);
+void * cpriqueue_remove_at(cpriqueue_t *q, int index);
+int    cpriqueue_size     (cpriqueue_t *q);
+
+void   cpriqueue_destroy  (cpriqueue_t *q);
+
+#endif /* LIBCPRIQUEUE_H_ */
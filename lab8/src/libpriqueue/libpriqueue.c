@@ -3,9 +3,310 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "libpriqueue.h"
 
+/*
+  Every heap call made on behalf of a queue goes through these wrappers so
+  the allocation counters stay accurate.
+ */
+static void *pq_malloc(priqueue_t *q, size_t size)
+{
+  q->alloc_count++;
+  return malloc(size);
+}
+
+static void *pq_realloc(priqueue_t *q, void *ptr, size_t size)
+{
+  q->alloc_count++;
+  if (ptr != NULL)
+    q->free_count++;
+  return realloc(ptr, size);
+}
+
+static void pq_free(priqueue_t *q, void *ptr)
+{
+  if (ptr == NULL)
+    return;
+  q->free_count++;
+  free(ptr);
+}
+
+/*
+  List nodes come from the per-queue pool when it is enabled. Each slab is
+  twice the size of the previous one and is only released by
+  priqueue_destroy().
+ */
+static void pool_grow(priqueue_t *q, int count)
+{
+  node_slab_t *slab = (node_slab_t *)pq_malloc(q, sizeof(node_slab_t) + count * sizeof(node_t));
+  slab->next = q->slabs;
+  q->slabs = slab;
+
+  for (int i = count - 1; i >= 0; i--)
+  {
+    slab->nodes[i].next = q->free_nodes;
+    q->free_nodes = &slab->nodes[i];
+  }
+}
+
+static node_t *node_alloc(priqueue_t *q)
+{
+  if (!q->pooled)
+    return (node_t *)pq_malloc(q, sizeof(node_t));
+
+  if (q->free_nodes == NULL)
+  {
+    pool_grow(q, q->slab_size);
+    q->slab_size *= 2;
+  }
+
+  node_t *node = q->free_nodes;
+  q->free_nodes = node->next;
+  return node;
+}
+
+static void node_free(priqueue_t *q, node_t *node)
+{
+  if (!q->pooled)
+  {
+    pq_free(q, node);
+    return;
+  }
+
+  node->next = q->free_nodes;
+  q->free_nodes = node;
+}
+
+/*
+  Heap backend helpers. Entries are ordered by the comparer first and by
+  insertion sequence second, which keeps equal elements in FIFO order.
+ */
+static int entry_before(const heap_entry_t *a, const heap_entry_t *b, int (*comparer)(const void *, const void *))
+{
+  int cmp = comparer(a->data, b->data);
+  if (cmp != 0)
+    return cmp < 0;
+  return a->seq < b->seq;
+}
+
+/*
+  The sift helpers also run on the sorted-view scratch array, which has no
+  handle table; pos is NULL there.
+ */
+static void heap_place(heap_entry_t *heap, int *pos, int index, heap_entry_t entry)
+{
+  heap[index] = entry;
+  if (pos != NULL)
+    pos[entry.handle] = index;
+}
+
+static int heap_sift_up(heap_entry_t *heap, int *pos, int index, int (*comparer)(const void *, const void *))
+{
+  heap_entry_t entry = heap[index];
+  while (index > 0)
+  {
+    int parent = (index - 1) / 2;
+    if (!entry_before(&entry, &heap[parent], comparer))
+      break;
+    heap_place(heap, pos, index, heap[parent]);
+    index = parent;
+  }
+  heap_place(heap, pos, index, entry);
+  return index;
+}
+
+static int heap_sift_down(heap_entry_t *heap, int *pos, int size, int index, int (*comparer)(const void *, const void *))
+{
+  heap_entry_t entry = heap[index];
+  for (;;)
+  {
+    int child = 2 * index + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && entry_before(&heap[child + 1], &heap[child], comparer))
+      child++;
+    if (!entry_before(&heap[child], &entry, comparer))
+      break;
+    heap_place(heap, pos, index, heap[child]);
+    index = child;
+  }
+  heap_place(heap, pos, index, entry);
+  return index;
+}
+
+static void heap_heapify(heap_entry_t *heap, int *pos, int size, int (*comparer)(const void *, const void *))
+{
+  for (int i = 0; i < size; i++)
+    pos[heap[i].handle] = i;
+  for (int i = size / 2 - 1; i >= 0; i--)
+    heap_sift_down(heap, pos, size, i, comparer);
+}
+
+static priqueue_handle_t handle_acquire(priqueue_t *q)
+{
+  if (q->handle_free_count > 0)
+    return q->handle_free[--q->handle_free_count];
+
+  if (q->handle_count == q->handle_capacity)
+  {
+    q->handle_capacity = q->handle_capacity ? q->handle_capacity * 2 : 16;
+    q->handle_pos = (int *)pq_realloc(q, q->handle_pos, q->handle_capacity * sizeof(int));
+    q->handle_free = (int *)pq_realloc(q, q->handle_free, q->handle_capacity * sizeof(int));
+  }
+  return q->handle_count++;
+}
+
+static void handle_release(priqueue_t *q, priqueue_handle_t handle)
+{
+  q->handle_pos[handle] = -1;
+  q->handle_free[q->handle_free_count++] = handle;
+}
+
+static int handle_valid(priqueue_t *q, priqueue_handle_t handle)
+{
+  return q->backend == PRIQUEUE_HEAP && handle >= 0 && handle < q->handle_count && q->handle_pos[handle] >= 0;
+}
+
+static void heap_reserve(priqueue_t *q, int needed)
+{
+  if (needed <= q->capacity)
+    return;
+
+  int capacity = q->capacity ? q->capacity : 16;
+  while (capacity < needed)
+    capacity *= 2;
+
+  q->heap = (heap_entry_t *)pq_realloc(q, q->heap, capacity * sizeof(heap_entry_t));
+  pq_free(q, q->ordered);
+  q->ordered = NULL;
+  q->ordered_valid = 0;
+  q->capacity = capacity;
+}
+
+static void *heap_delete(priqueue_t *q, int index)
+{
+  heap_entry_t removed = q->heap[index];
+  handle_release(q, removed.handle);
+
+  q->size--;
+  if (index != q->size)
+  {
+    heap_place(q->heap, q->handle_pos, index, q->heap[q->size]);
+    index = heap_sift_up(q->heap, q->handle_pos, index, q->comparer);
+    heap_sift_down(q->heap, q->handle_pos, q->size, index, q->comparer);
+  }
+  q->ordered_valid = 0;
+  return removed.data;
+}
+
+/*
+  Builds the sorted view of the heap used by priqueue_at() and
+  priqueue_remove_at(). The view stays valid until the queue is modified.
+ */
+static heap_entry_t *heap_ordered(priqueue_t *q)
+{
+  if (q->ordered_valid)
+    return q->ordered;
+
+  if (q->ordered == NULL)
+    q->ordered = (heap_entry_t *)pq_malloc(q, q->capacity * sizeof(heap_entry_t));
+
+  // Heapsort a copy: each pass moves the current minimum to the end, which
+  // leaves the array in descending order, so reverse it afterwards.
+  memcpy(q->ordered, q->heap, q->size * sizeof(heap_entry_t));
+  for (int last = q->size - 1; last > 0; last--)
+  {
+    heap_entry_t top = q->ordered[0];
+    q->ordered[0] = q->ordered[last];
+    q->ordered[last] = top;
+    heap_sift_down(q->ordered, NULL, last, 0, q->comparer);
+  }
+  for (int i = 0, j = q->size - 1; i < j; i++, j--)
+  {
+    heap_entry_t tmp = q->ordered[i];
+    q->ordered[i] = q->ordered[j];
+    q->ordered[j] = tmp;
+  }
+
+  q->ordered_valid = 1;
+  return q->ordered;
+}
+
+/*
+  Batch helpers. A run is a caller-supplied array of elements; the list
+  backend merges it in one pass once it is sorted, and the sort is a stable
+  merge sort so equal elements keep their array order.
+ */
+static int run_sorted(void **items, int count, int (*comparer)(const void *, const void *))
+{
+  for (int i = 1; i < count; i++)
+    if (comparer(items[i - 1], items[i]) > 0)
+      return 0;
+  return 1;
+}
+
+static void run_sort(void **items, void **scratch, int count, int (*comparer)(const void *, const void *))
+{
+  if (count < 2)
+    return;
+
+  int half = count / 2;
+  run_sort(items, scratch, half, comparer);
+  run_sort(items + half, scratch, count - half, comparer);
+
+  int i = 0, j = half, k = 0;
+  while (i < half && j < count)
+    scratch[k++] = comparer(items[j], items[i]) < 0 ? items[j++] : items[i++];
+  while (i < half)
+    scratch[k++] = items[i++];
+  while (j < count)
+    scratch[k++] = items[j++];
+  memcpy(items, scratch, count * sizeof(void *));
+}
+
+static void list_merge_run(priqueue_t *q, void **items, int count)
+{
+  node_t **link = &q->head;
+  for (int i = 0; i < count; i++)
+  {
+    // Skip past everything that does not sort strictly after the new
+    // element, as priqueue_offer() does, so ties stay FIFO.
+    while (*link != NULL && q->comparer(items[i], (*link)->data) >= 0)
+      link = &(*link)->next;
+
+    node_t *new_node = node_alloc(q);
+    new_node->data = items[i];
+    new_node->next = *link;
+    *link = new_node;
+    link = &new_node->next;
+  }
+  q->size += count;
+}
+
+static void heap_append_run(priqueue_t *q, void **items, int count)
+{
+  int old_size = q->size;
+  heap_reserve(q, q->size + count);
+
+  for (int i = 0; i < count; i++)
+  {
+    priqueue_handle_t handle = handle_acquire(q);
+    heap_place(q->heap, q->handle_pos, q->size++, (heap_entry_t){.data = items[i], .seq = q->next_seq++, .handle = handle});
+  }
+
+  // Floyd's bottom-up build is O(n) over the whole heap; sifting each new
+  // element up is O(count log n). Use whichever is cheaper.
+  if (count > old_size)
+    heap_heapify(q->heap, q->handle_pos, q->size, q->comparer);
+  else
+    for (int i = old_size; i < q->size; i++)
+      heap_sift_up(q->heap, q->handle_pos, i, q->comparer);
+
+  q->ordered_valid = 0;
+}
+
 /**
   Initializes the priqueue_t data structure.
 
@@ -17,10 +318,92 @@
   See also @ref comparer-page
  */
 void priqueue_init(priqueue_t *q, int (*comparer)(const void *, const void *))
+{
+  priqueue_init_backend(q, comparer, PRIQUEUE_LIST);
+}
+
+/**
+  Initializes the priqueue_t data structure with an explicit storage backend.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param backend PRIQUEUE_LIST for the sorted linked list, PRIQUEUE_HEAP for the binary heap
+ */
+void priqueue_init_backend(priqueue_t *q, int (*comparer)(const void *, const void *), priqueue_backend_t backend)
 {
   q->head = NULL;
   q->size = 0;
   q->comparer = comparer;
+
+  q->backend = backend;
+  q->heap = NULL;
+  q->ordered = NULL;
+  q->capacity = 0;
+  q->ordered_valid = 0;
+  q->next_seq = 0;
+
+  q->handle_pos = NULL;
+  q->handle_free = NULL;
+  q->handle_capacity = 0;
+  q->handle_free_count = 0;
+  q->handle_count = 0;
+
+  q->pooled = 0;
+  q->slab_size = 0;
+  q->free_nodes = NULL;
+  q->slabs = NULL;
+
+  q->alloc_count = 0;
+  q->free_count = 0;
+}
+
+/**
+  Initializes the priqueue_t data structure so that steady-state offer and
+  poll make no heap calls.
+
+  The list backend recycles nodes through a per-queue free list; the heap
+  backend simply keeps its arrays. Both are sized up front for reserve
+  elements and grow geometrically past that.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param backend PRIQUEUE_LIST for the sorted linked list, PRIQUEUE_HEAP for the binary heap
+  @param reserve number of elements to allocate room for up front, or 0
+ */
+void priqueue_init_pool(priqueue_t *q, int (*comparer)(const void *, const void *), priqueue_backend_t backend, int reserve)
+{
+  priqueue_init_backend(q, comparer, backend);
+
+  if (backend == PRIQUEUE_HEAP)
+  {
+    if (reserve > 0)
+      heap_reserve(q, reserve);
+    return;
+  }
+
+  q->pooled = 1;
+  q->slab_size = 64;
+  if (reserve > 0)
+    pool_grow(q, reserve);
+}
+
+/**
+  Initializes the priqueue_t data structure with count known elements.
+
+  The heap backend is built with an O(n) heapify; the list backend sorts a
+  copy of the array and links it in one pass. Elements that compare equal
+  keep their array order.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param comparer a function pointer that compares two elements.
+  @param backend PRIQUEUE_LIST for the sorted linked list, PRIQUEUE_HEAP for the binary heap
+  @param items the elements to queue
+  @param count the number of elements in items
+ */
+void priqueue_init_from_array(priqueue_t *q, int (*comparer)(const void *, const void *), priqueue_backend_t backend, void **items, int count)
+{
+  priqueue_init_backend(q, comparer, backend);
+  priqueue_offer_batch(q, items, count);
 }
 
 /**
@@ -29,10 +412,17 @@ void priqueue_init(priqueue_t *q, int (*comparer)(const void *, const void *))
   @param q a pointer to an instance of the priqueue_t data structure
   @param ptr a pointer to the data to be inserted into the priority queue
   @return The zero-based index where ptr is stored in the priority queue, where 0 indicates that ptr was stored at the front of the priority queue.
+  With the heap backend this is the slot in the heap array, so 0 still means ptr is at the front.
  */
 int priqueue_offer(priqueue_t *q, void *ptr)
 {
-  node_t *new_node = (node_t *)malloc(sizeof(node_t));
+  if (q->backend == PRIQUEUE_HEAP)
+  {
+    priqueue_handle_t handle = priqueue_offer_handle(q, ptr);
+    return q->handle_pos[handle];
+  }
+
+  node_t *new_node = node_alloc(q);
   new_node->data = ptr;
   new_node->next = NULL;
 
@@ -59,6 +449,46 @@ int priqueue_offer(priqueue_t *q, void *ptr)
   return index + 1;
 }
 
+/**
+  Insert count elements into this priority queue at once.
+
+  With the list backend, a run that is already sorted by the comparer is
+  merged into the queue in a single pass; an unsorted run is sorted first.
+  With the heap backend the elements are appended and the heap is rebuilt
+  or sifted, whichever is cheaper. Elements that compare equal are queued
+  after existing equal elements, in array order.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param items the elements to insert
+  @param count the number of elements in items
+  @return the number of elements inserted
+ */
+int priqueue_offer_batch(priqueue_t *q, void **items, int count)
+{
+  if (count <= 0)
+    return 0;
+
+  if (q->backend == PRIQUEUE_HEAP)
+  {
+    heap_append_run(q, items, count);
+    return count;
+  }
+
+  if (run_sorted(items, count, q->comparer))
+  {
+    list_merge_run(q, items, count);
+    return count;
+  }
+
+  void **run = (void **)pq_malloc(q, 2 * count * sizeof(void *));
+  memcpy(run, items, count * sizeof(void *));
+  run_sort(run, run + count, count, q->comparer);
+  list_merge_run(q, run, count);
+  pq_free(q, run);
+
+  return count;
+}
+
 /**
   Retrieves, but does not remove, the head of this queue, returning NULL if
   this queue is empty.
@@ -69,6 +499,9 @@ int priqueue_offer(priqueue_t *q, void *ptr)
  */
 void *priqueue_peek(priqueue_t *q)
 {
+  if (q->backend == PRIQUEUE_HEAP)
+    return q->size > 0 ? q->heap[0].data : NULL;
+
   if (q->head == NULL)
     return NULL;
   return q->head->data;
@@ -84,13 +517,21 @@ void *priqueue_peek(priqueue_t *q)
  */
 void *priqueue_poll(priqueue_t *q)
 {
+  if (q->backend == PRIQUEUE_HEAP)
+  {
+    if (q->size == 0)
+      return NULL;
+
+    return heap_delete(q, 0);
+  }
+
   if (q->head == NULL)
     return NULL;
 
   node_t *temp = q->head;
   void *data = temp->data;
   q->head = q->head->next;
-  free(temp);
+  node_free(q, temp);
   q->size--;
 
   return data;
@@ -100,6 +541,9 @@ void *priqueue_poll(priqueue_t *q)
   Returns the element at the specified position in this list, or NULL if
   the queue does not contain an index'th element.
 
+  The heap backend answers from a sorted view that is rebuilt in O(n log n)
+  after each modification, so walking the whole queue stays cheap.
+
   @param q a pointer to an instance of the priqueue_t data structure
   @param index position of retrieved element
   @return the index'th element in the queue
@@ -110,6 +554,9 @@ void *priqueue_at(priqueue_t *q, int index)
   if (index < 0 || index >= q->size)
     return NULL;
 
+  if (q->backend == PRIQUEUE_HEAP)
+    return heap_ordered(q)[index].data;
+
   node_t *current = q->head;
   for (int i = 0; i < index; i++)
   {
@@ -130,6 +577,30 @@ void *priqueue_at(priqueue_t *q, int index)
 int priqueue_remove(priqueue_t *q, void *ptr)
 {
   int count = 0;
+
+  if (q->backend == PRIQUEUE_HEAP)
+  {
+    int kept = 0;
+    for (int i = 0; i < q->size; i++)
+    {
+      if (q->heap[i].data == ptr)
+      {
+        handle_release(q, q->heap[i].handle);
+        count++;
+      }
+      else
+        q->heap[kept++] = q->heap[i];
+    }
+
+    if (count > 0)
+    {
+      q->size = kept;
+      heap_heapify(q->heap, q->handle_pos, q->size, q->comparer);
+      q->ordered_valid = 0;
+    }
+    return count;
+  }
+
   node_t **current = &q->head;
 
   while (*current != NULL)
@@ -138,7 +609,7 @@ int priqueue_remove(priqueue_t *q, void *ptr)
     if (entry->data == ptr)
     {
       *current = entry->next;
-      free(entry);
+      node_free(q, entry);
       q->size--;
       count++;
     }
@@ -165,6 +636,12 @@ void *priqueue_remove_at(priqueue_t *q, int index)
   if (index < 0 || index >= q->size)
     return NULL;
 
+  if (q->backend == PRIQUEUE_HEAP)
+  {
+    priqueue_handle_t handle = heap_ordered(q)[index].handle;
+    return heap_delete(q, q->handle_pos[handle]);
+  }
+
   node_t **current = &q->head;
   for (int i = 0; i < index; i++)
   {
@@ -174,7 +651,7 @@ void *priqueue_remove_at(priqueue_t *q, int index)
   node_t *temp = *current;
   void *data = temp->data;
   *current = temp->next;
-  free(temp);
+  node_free(q, temp);
   q->size--;
 
   return data;
@@ -191,6 +668,91 @@ int priqueue_size(priqueue_t *q)
   return q->size;
 }
 
+/**
+  Insert the specified element into this priority queue and return a handle
+  that can later be used to remove or re-key it in O(log n).
+
+  Handles are only supported by the heap backend.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param ptr a pointer to the data to be inserted into the priority queue
+  @return a handle to the queued element
+  @return -1 if q does not use the heap backend
+ */
+priqueue_handle_t priqueue_offer_handle(priqueue_t *q, void *ptr)
+{
+  if (q->backend != PRIQUEUE_HEAP)
+    return -1;
+
+  heap_reserve(q, q->size + 1);
+  priqueue_handle_t handle = handle_acquire(q);
+  heap_place(q->heap, q->handle_pos, q->size, (heap_entry_t){.data = ptr, .seq = q->next_seq++, .handle = handle});
+  heap_sift_up(q->heap, q->handle_pos, q->size, q->comparer);
+  q->size++;
+  q->ordered_valid = 0;
+
+  return handle;
+}
+
+/**
+  Removes the element referred to by handle from the queue.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle()
+  @return the element removed from the queue
+  @return NULL if handle does not refer to a queued element
+ */
+void *priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle)
+{
+  if (!handle_valid(q, handle))
+    return NULL;
+  return heap_delete(q, q->handle_pos[handle]);
+}
+
+/**
+  Restores the queue order after the key of the element referred to by
+  handle has been changed in place by the caller.
+
+  The element keeps its original arrival order relative to equal elements.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @param handle a handle returned by priqueue_offer_handle()
+  @return the new zero-based slot of the element in the heap
+  @return -1 if handle does not refer to a queued element
+ */
+int priqueue_update_key(priqueue_t *q, priqueue_handle_t handle)
+{
+  if (!handle_valid(q, handle))
+    return -1;
+
+  int index = heap_sift_up(q->heap, q->handle_pos, q->handle_pos[handle], q->comparer);
+  index = heap_sift_down(q->heap, q->handle_pos, q->size, index, q->comparer);
+  q->ordered_valid = 0;
+  return index;
+}
+
+/**
+  Returns the number of heap allocations (malloc/realloc) q has made.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return the number of allocations made on behalf of q
+ */
+unsigned long priqueue_alloc_count(priqueue_t *q)
+{
+  return q->alloc_count;
+}
+
+/**
+  Returns the number of blocks q has handed back to the heap.
+
+  @param q a pointer to an instance of the priqueue_t data structure
+  @return the number of frees made on behalf of q
+ */
+unsigned long priqueue_free_count(priqueue_t *q)
+{
+  return q->free_count;
+}
+
 /**
   Destroys and frees all the memory associated with q.
 
@@ -202,9 +764,32 @@ void priqueue_destroy(priqueue_t *q)
   while (current != NULL)
   {
     node_t *next = current->next;
-    free(current);
+    node_free(q, current);
     current = next;
   }
   q->head = NULL;
   q->size = 0;
+
+  while (q->slabs != NULL)
+  {
+    node_slab_t *next = q->slabs->next;
+    pq_free(q, q->slabs);
+    q->slabs = next;
+  }
+  q->free_nodes = NULL;
+
+  pq_free(q, q->heap);
+  pq_free(q, q->ordered);
+  q->heap = NULL;
+  q->ordered = NULL;
+  q->capacity = 0;
+  q->ordered_valid = 0;
+
+  pq_free(q, q->handle_pos);
+  pq_free(q, q->handle_free);
+  q->handle_pos = NULL;
+  q->handle_free = NULL;
+  q->handle_capacity = 0;
+  q->handle_free_count = 0;
+  q->handle_count = 0;
 }
@@ -11,6 +11,41 @@ typedef struct node
   struct node *next;
 } node_t;
 
+/**
+  A block of list nodes carved up by the per-queue node pool.
+*/
+typedef struct node_slab
+{
+  struct node_slab *next;
+  node_t nodes[];
+} node_slab_t;
+
+/**
+  Storage strategies available to a priqueue_t.
+
+  PRIQUEUE_LIST keeps a sorted singly linked list (O(n) offer, O(1) poll).
+  PRIQUEUE_HEAP keeps an array-backed binary heap (O(log n) offer and poll).
+  Both keep FIFO order among elements that compare equal.
+*/
+typedef enum {PRIQUEUE_LIST = 0, PRIQUEUE_HEAP} priqueue_backend_t;
+
+/**
+  Stable reference to an element queued in the heap backend. A handle stays
+  valid until its element leaves the queue, after which it may be reused.
+*/
+typedef int priqueue_handle_t;
+
+/**
+  A slot in the heap backend. The sequence number breaks ties between equal
+  elements so the heap is stable.
+*/
+typedef struct
+{
+  void *data;
+  unsigned long seq;
+  priqueue_handle_t handle;
+} heap_entry_t;
+
 /**
   Priqueue Data Structure
 */
@@ -19,11 +54,36 @@ typedef struct
   node_t *head;
   int size;
   int (*comparer)(const void *, const void *);
+
+  priqueue_backend_t backend;
+  heap_entry_t *heap;
+  heap_entry_t *ordered;
+  int capacity;
+  int ordered_valid;
+  unsigned long next_seq;
+
+  int *handle_pos;
+  int *handle_free;
+  int handle_capacity;
+  int handle_free_count;
+  int handle_count;
+
+  int pooled;
+  int slab_size;
+  node_t *free_nodes;
+  node_slab_t *slabs;
+
+  unsigned long alloc_count;
+  unsigned long free_count;
 } priqueue_t;
 
 void   priqueue_init     (priqueue_t *q, int(*comparer)(const void *, const void *));
+void   priqueue_init_backend(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend);
+void   priqueue_init_pool(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend, int reserve);
+void   priqueue_init_from_array(priqueue_t *q, int(*comparer)(const void *, const void *), priqueue_backend_t backend, void **items, int count);
 
 int    priqueue_offer    (priqueue_t *q, void *ptr);
+int    priqueue_offer_batch(priqueue_t *q, void **items, int count);
 void * priqueue_peek     (priqueue_t *q);
 void * priqueue_poll     (priqueue_t *q);
 void * priqueue_at       (priqueue_t *q, int index);
@@ -31,6 +91,13 @@ int    priqueue_remove   (priqueue_t *q, void *ptr);
 void * priqueue_remove_at(priqueue_t *q, int index);
 int    priqueue_size     (priqueue_t *q);
 
+priqueue_handle_t priqueue_offer_handle (priqueue_t *q, void *ptr);
+void * priqueue_remove_handle(priqueue_t *q, priqueue_handle_t handle);
+int    priqueue_update_key   (priqueue_t *q, priqueue_handle_t handle);
+
+unsigned long priqueue_alloc_count(priqueue_t *q);
+unsigned long priqueue_free_count (priqueue_t *q);
+
 void   priqueue_destroy  (priqueue_t *q);
 
 #endif /* LIBPQUEUE_H_ */
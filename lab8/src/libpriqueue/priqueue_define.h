@@ -0,0 +1,134 @@
+/** @file priqueue_define.h
+
+  Compile-time specialized priority queues.
+
+  PRIQUEUE_DEFINE(name, type, cmp) expands to a stable binary heap whose
+  entries hold a key of the given type next to the payload pointer, so a
+  sift touches one contiguous array and never dereferences the payload.
+  cmp(a, b) receives two keys by value and returns <0, 0 or >0 like a
+  priqueue_t comparer; it may be a macro or a static inline function, and
+  either way it is inlined into the generated code.
+
+  Generated API, for PRIQUEUE_DEFINE(jobq, int, INT_CMP):
+
+    jobq_t   the queue type
+    void     jobq_init   (jobq_t *q);
+    int      jobq_offer  (jobq_t *q, int key, void *data);
+    void *   jobq_peek   (jobq_t *q);
+    int      jobq_peek_key(jobq_t *q);   q must not be empty
+    void *   jobq_poll   (jobq_t *q);
+    int      jobq_size   (jobq_t *q);
+    void     jobq_destroy(jobq_t *q);
+
+  Equal keys are served in FIFO order, as with priqueue_t.
+ */
+
+#ifndef PRIQUEUE_DEFINE_H_
+#define PRIQUEUE_DEFINE_H_
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define PRIQUEUE_DEFINE(name, type, cmp)                                        \
+  typedef struct                                                                \
+  {                                                                             \
+    type key;                                                                   \
+    unsigned long seq;                                                          \
+    void *data;                                                                 \
+  } name##_entry_t;                                                             \
+                                                                                \
+  typedef struct                                                                \
+  {                                                                             \
+    name##_entry_t *entries;                                                    \
+    int size;                                                                   \
+    int capacity;                                                               \
+    unsigned long next_seq;                                                     \
+  } name##_t;                                                                   \
+                                                                                \
+  static inline int name##_before(const name##_entry_t *a,                      \
+                                  const name##_entry_t *b)                      \
+  {                                                                             \
+    int c = cmp(a->key, b->key);                                                \
+    return c < 0 || (c == 0 && a->seq < b->seq);                                \
+  }                                                                             \
+                                                                                \
+  static inline void name##_init(name##_t *q)                                   \
+  {                                                                             \
+    q->entries = NULL;                                                          \
+    q->size = 0;                                                                \
+    q->capacity = 0;                                                            \
+    q->next_seq = 0;                                                            \
+  }                                                                             \
+                                                                                \
+  static inline int name##_offer(name##_t *q, type key, void *data)            \
+  {                                                                             \
+    if (q->size == q->capacity)                                                 \
+    {                                                                           \
+      q->capacity = q->capacity ? q->capacity * 2 : 16;                         \
+      q->entries = (name##_entry_t *)realloc(                                   \
+          q->entries, q->capacity * sizeof(name##_entry_t));                    \
+    }                                                                           \
+                                                                                \
+    name##_entry_t entry = {.key = key, .seq = q->next_seq++, .data = data};    \
+    int index = q->size++;                                                      \
+    while (index > 0)                                                           \
+    {                                                                           \
+      int parent = (index - 1) / 2;                                             \
+      if (!name##_before(&entry, &q->entries[parent]))                          \
+        break;                                                                  \
+      q->entries[index] = q->entries[parent];                                   \
+      index = parent;                                                           \
+    }                                                                           \
+    q->entries[index] = entry;                                                  \
+    return index;                                                               \
+  }                                                                             \
+                                                                                \
+  static inline void *name##_peek(name##_t *q)                                  \
+  {                                                                             \
+    return q->size > 0 ? q->entries[0].data : NULL;                             \
+  }                                                                             \
+                                                                                \
+  static inline type name##_peek_key(name##_t *q)                               \
+  {                                                                             \
+    assert(q->size > 0);                                                        \
+    return q->entries[0].key;                                                   \
+  }                                                                             \
+                                                                                \
+  static inline void *name##_poll(name##_t *q)                                  \
+  {                                                                             \
+    if (q->size == 0)                                                           \
+      return NULL;                                                              \
+                                                                                \
+    void *data = q->entries[0].data;                                            \
+    name##_entry_t entry = q->entries[--q->size];                               \
+    int index = 0;                                                              \
+    for (;;)                                                                    \
+    {                                                                           \
+      int child = 2 * index + 1;                                                \
+      if (child >= q->size)                                                     \
+        break;                                                                  \
+      if (child + 1 < q->size &&                                                \
+          name##_before(&q->entries[child + 1], &q->entries[child]))            \
+        child++;                                                                \
+      if (!name##_before(&q->entries[child], &entry))                           \
+        break;                                                                  \
+      q->entries[index] = q->entries[child];                                    \
+      index = child;                                                            \
+    }                                                                           \
+    if (q->size > 0)                                                            \
+      q->entries[index] = entry;                                                \
+    return data;                                                                \
+  }                                                                             \
+                                                                                \
+  static inline int name##_size(name##_t *q)                                    \
+  {                                                                             \
+    return q->size;                                                             \
+  }                                                                             \
+                                                                                \
+  static inline void name##_destroy(name##_t *q)                                \
+  {                                                                             \
+    free(q->entries);                                                           \
+    name##_init(q);                                                             \
+  }
+
+#endif /* PRIQUEUE_DEFINE_H_ */
@@ -0,0 +1,98 @@
+/** @file histogram.c
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+/*
+  Bucket of a value. Below HISTOGRAM_SUB_COUNT the bucket is the value.
+  Above it, the top HISTOGRAM_SUB_BITS + 1 bits of the value select the
+  bucket within the range of its highest set bit.
+ */
+static int bucket_of(int value)
+{
+  if (value < HISTOGRAM_SUB_COUNT)
+    return value;
+
+  int shift = (31 - __builtin_clz(value)) - HISTOGRAM_SUB_BITS;
+  return (shift + 1) * HISTOGRAM_SUB_COUNT + ((value >> shift) - HISTOGRAM_SUB_COUNT);
+}
+
+/*
+  Largest value that falls into bucket.
+ */
+static int bucket_highest(int bucket)
+{
+  if (bucket < HISTOGRAM_SUB_COUNT)
+    return bucket;
+
+  int shift = bucket / HISTOGRAM_SUB_COUNT - 1;
+  long long lowest = (long long)(bucket % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT) << shift;
+  return (int)(lowest + (1LL << shift) - 1);
+}
+
+/**
+  Initializes an empty histogram.
+
+  @param h a pointer to the histogram
+*/
+void histogram_init(histogram_t *h)
+{
+  memset(h, 0, sizeof(histogram_t));
+}
+
+/**
+  Records one value. Negative values are recorded as 0.
+
+  @param h a pointer to the histogram
+  @param value the value to record
+*/
+void histogram_record(histogram_t *h, int value)
+{
+  if (value < 0)
+    value = 0;
+
+  h->counts[bucket_of(value)]++;
+  h->total++;
+  if (value > h->max)
+    h->max = value;
+}
+
+/**
+  Returns the value below which percentile percent of the recorded values
+  fall. The result is the highest value of its bucket, and never more than
+  the largest value recorded.
+
+  @param h a pointer to the histogram
+  @param percentile a percentage from 0 to 100; 100 gives the maximum
+  @return the value at the percentile, or 0 if nothing was recorded
+*/
+int histogram_percentile(const histogram_t *h, double percentile)
+{
+  if (h->total == 0)
+    return 0;
+  if (percentile >= 100.0)
+    return h->max;
+
+  // Nearest rank: the smallest value with at least percentile% at or below it
+  double exact = percentile / 100.0 * h->total;
+  long long rank = (long long)exact;
+  if (rank < exact)
+    rank++;
+  if (rank < 1)
+    rank = 1;
+
+  long long seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+  {
+    seen += h->counts[i];
+    if (seen >= rank)
+    {
+      int value = bucket_highest(i);
+      return value < h->max ? value : h->max;
+    }
+  }
+
+  return h->max;
+}
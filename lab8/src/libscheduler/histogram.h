@@ -0,0 +1,36 @@
+/** @file histogram.h
+ */
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+/**
+  Each power of two range is split into 2^HISTOGRAM_SUB_BITS equal
+  buckets, so a recorded value is off by at most 1/32 (about 3%).
+*/
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+
+/**
+  Enough buckets for every non-negative int.
+*/
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_COUNT)
+
+/**
+  Log-bucketed histogram in the style of HdrHistogram. Values below
+  HISTOGRAM_SUB_COUNT are kept exactly; above that the bucket width grows
+  with the value. Memory use does not depend on how many values are
+  recorded.
+*/
+typedef struct
+{
+  unsigned int counts[HISTOGRAM_BUCKETS];
+  long long total;
+  int max;
+} histogram_t;
+
+void histogram_init      (histogram_t *h);
+void histogram_record    (histogram_t *h, int value);
+int  histogram_percentile(const histogram_t *h, double percentile);
+
+#endif /* HISTOGRAM_H_ */
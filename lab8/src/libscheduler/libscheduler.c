@@ -6,6 +6,8 @@
 #include <string.h>
 
 #include "libscheduler.h"
+#include "histogram.h"
+#include "schedlog.h"
 #include "../libpriqueue/libpriqueue.h"
 
 /**
@@ -23,6 +25,13 @@ typedef struct _job_t
   int start_time;
   int end_time;
   int started;
+
+  int level;          /* MLFQ: current queue, 0 is the highest */
+  int quanta_used;    /* MLFQ: quanta run at the current level */
+  long long vruntime; /* CFS: weighted run time, see cfs_charge() */
+  int slice_start;    /* MLFQ/CFS: time the job was last put on a core */
+  int last_core;      /* core the job last ran on, or -1 */
+  priqueue_handle_t running_handle; /* PSJF/PPRI: entry in running, or -1 */
 } job_t;
 
 typedef struct _core_t
@@ -31,15 +40,69 @@ typedef struct _core_t
   job_t *job;
 } core_t;
 
-core_t *core_array;
-int total_cores;
-scheme_t scheduling_scheme;
-priqueue_t job_queue;
+/**
+  Number of MLFQ levels. A job at level l runs for 2^l quanta before it is
+  moved down one level, so long jobs get fewer but longer turns.
+*/
+#define MLFQ_LEVELS 3
+
+/**
+  Every MLFQ_BOOST_PERIOD time units all MLFQ jobs return to level 0, so
+  jobs at the bottom level cannot starve.
+*/
+#define MLFQ_BOOST_PERIOD 50
+
+/**
+  CFS weight of a job with priority 0. Priority is read as a nice value
+  from -20 to 19, with the same weights as the Linux scheduler.
+*/
+#define CFS_NICE_0_WEIGHT 1024
+
+static const int cfs_prio_to_weight[40] = {
+ /* -20 */ 88761, 71755, 56483, 46273, 36291,
+ /* -15 */ 29154, 23254, 18705, 14949, 11916,
+ /* -10 */  9548,  7620,  6100,  4904,  3906,
+ /*  -5 */  3121,  2501,  1991,  1586,  1277,
+ /*   0 */  1024,   820,   655,   526,   423,
+ /*   5 */   335,   272,   215,   172,   137,
+ /*  10 */   110,    87,    70,    56,    45,
+ /*  15 */    36,    29,    23,    18,    15,
+};
+
+/**
+  All state belonging to one scheduler instance. Several instances can be
+  used side by side, for example from different threads.
+*/
+struct _scheduler_t
+{
+  core_t *core_array;
+  int total_cores;
+  scheme_t scheduling_scheme;
+  priqueue_t job_queue;
+  priqueue_t *run_queues; /* one per core if enabled, otherwise NULL */
+
+  unsigned long long *idle_cores; /* bit i is set while core i is idle */
+  priqueue_t running;             /* PSJF/PPRI: running jobs, best victim first */
 
-int total_jobs_completed = 0;
-float total_waiting_time = 0;
-float total_turnaround_time = 0;
-float total_response_time = 0;
+  priqueue_t mlfq_queues[MLFQ_LEVELS]; /* MLFQ only; job_queue stays empty */
+  int next_boost;
+  long long min_vruntime; /* CFS: lowest vruntime of running and waiting jobs, never decreases */
+
+  int total_jobs_completed;
+  float total_waiting_time;
+  float total_turnaround_time;
+  float total_response_time;
+  histogram_t waiting_times;
+  histogram_t turnaround_times;
+  histogram_t response_times;
+  int migrations;
+  schedlog_t *log; /* every decision is appended here if not NULL */
+};
+
+/**
+  The instance behind the scheduler_* functions used by the simulator.
+*/
+static scheduler_t *default_scheduler = NULL;
 
 typedef int(comparer)(const void *, const void *);
 
@@ -71,6 +134,41 @@ int compare_rr(const void *a, const void *b)
   return 0;
 }
 
+int compare_cfs(const void *a, const void *b)
+{
+  const job_t *job_a = (const job_t *)a;
+  const job_t *job_b = (const job_t *)b;
+  return (job_a->vruntime > job_b->vruntime) - (job_a->vruntime < job_b->vruntime);
+}
+
+/*
+  Orders running jobs so the best preemption victim comes first: the one
+  that will finish last, or the one with the lowest priority. Among equals
+  the job that arrived last is preempted.
+
+  remaining_time + slice_start is when a running job will finish. Unlike
+  the remaining time itself, it does not change while the job runs.
+ */
+int compare_victim_psjf(const void *a, const void *b)
+{
+  const job_t *job_a = (const job_t *)a;
+  const job_t *job_b = (const job_t *)b;
+  int finish_a = job_a->remaining_time + job_a->slice_start;
+  int finish_b = job_b->remaining_time + job_b->slice_start;
+  if (finish_a == finish_b)
+    return job_b->arrival_time - job_a->arrival_time;
+  return finish_b - finish_a;
+}
+
+int compare_victim_ppri(const void *a, const void *b)
+{
+  const job_t *job_a = (const job_t *)a;
+  const job_t *job_b = (const job_t *)b;
+  if (job_a->priority == job_b->priority)
+    return job_b->arrival_time - job_a->arrival_time;
+  return job_b->priority - job_a->priority;
+}
+
 // ok this is dumb, and was written before globalizec scheme set in startup
 // but w/e
 int (*job_comparer(scheme_t scheme))(const void *a, const void *b)
@@ -86,8 +184,11 @@ int (*job_comparer(scheme_t scheme))(const void *a, const void *b)
   case PPRI:
     return compare_pri_ppri;
   case RR:
+  case MLFQ:
     // this is handled by the simulator when our quantum slice expires
     return compare_rr;
+  case CFS:
+    return compare_cfs;
   default:
     return compare_fcfs; // Default to FCFS
   }
@@ -103,44 +204,446 @@ int (*job_comparer(scheme_t scheme))(const void *a, const void *b)
     - You may assume that scheme is a valid scheduling scheme.
 
   @param cores the number of cores that is available by the scheduler. These cores will be known as core(id=0), core(id=1), ..., core(id=cores-1).
-  @param scheme  the scheduling scheme that should be used. This value will be one of the six enum values of scheme_t
+  @param scheme  the scheduling scheme that should be used. This value will be one of the enum values of scheme_t
 */
 void scheduler_start_up(int cores, scheme_t scheme)
 {
-  total_cores = cores;
-  scheduling_scheme = scheme;
+  default_scheduler = scheduler_create(cores, scheme);
+}
+
+/**
+  Creates an independent scheduler instance.
+
+  @param cores the number of cores that is available by the scheduler.
+  @param scheme the scheduling scheme that should be used.
+  @return a new scheduler; release it with scheduler_destroy()
+*/
+scheduler_t *scheduler_create(int cores, scheme_t scheme)
+{
+  scheduler_t *s = (scheduler_t *)malloc(sizeof(scheduler_t));
 
-  core_array = malloc(sizeof(core_t) * cores);
+  s->total_cores = cores;
+  s->scheduling_scheme = scheme;
+
+  s->core_array = malloc(sizeof(core_t) * cores);
+  s->idle_cores = calloc((cores + 63) / 64, sizeof(unsigned long long));
   for (int i = 0; i < cores; i++)
   {
-    core_array[i].is_idle = 1;
-    core_array[i].job = NULL;
+    s->core_array[i].is_idle = 1;
+    s->core_array[i].job = NULL;
+    s->idle_cores[i / 64] |= 1ULL << (i % 64);
   }
 
-  priqueue_init(&job_queue, job_comparer(scheme));
+  priqueue_init_backend(&s->job_queue, job_comparer(scheme), PRIQUEUE_HEAP);
+  if (scheme == PSJF || scheme == PPRI)
+    priqueue_init_backend(&s->running, scheme == PPRI ? compare_victim_ppri : compare_victim_psjf, PRIQUEUE_HEAP);
+  if (scheme == MLFQ)
+    for (int i = 0; i < MLFQ_LEVELS; i++)
+      priqueue_init_backend(&s->mlfq_queues[i], compare_rr, PRIQUEUE_HEAP);
+  s->run_queues = NULL;
+  s->next_boost = MLFQ_BOOST_PERIOD;
+  s->min_vruntime = 0;
+  s->migrations = 0;
+  s->log = NULL;
+
+  s->total_jobs_completed = 0;
+  s->total_waiting_time = 0;
+  s->total_turnaround_time = 0;
+  s->total_response_time = 0;
+  histogram_init(&s->waiting_times);
+  histogram_init(&s->turnaround_times);
+  histogram_init(&s->response_times);
+
+  return s;
 }
 
 /**
-  Called when a new job arrives.
+  Returns non-zero if the simulator should call scheduler_quantum_expired()
+  for this scheme every quantum.
 
-  If multiple cores are idle, the job should be assigned to the core with the
-  lowest id.
-  If the job arriving should be scheduled to run during the next
-  time cycle, return the zero-based index of the core the job should be
-  scheduled on. If another job is already running on the core specified,
-  this will preempt the currently running job.
-  Assumption:
-    - You may assume that every job wil have a unique arrival time.
+  @param scheme a scheduling scheme
+  @return 1 for RR, MLFQ and CFS, otherwise 0
+*/
+int scheduler_uses_quantum(scheme_t scheme)
+{
+  return scheme == RR || scheme == MLFQ || scheme == CFS;
+}
 
-  @param job_number a globally unique identification number of the job arriving.
-  @param time the current time of the simulator.
-  @param running_time the total number of time units this job will run before it will be finished.
-  @param priority the priority of the job. (The lower the value, the higher the priority.)
-  @return index of core job should be scheduled on
-  @return -1 if no scheduling changes should be made.
+/**
+  Gives each core its own run queue. New jobs go to the least loaded core
+  and a core that runs out of work steals from the busiest one. MLFQ keeps
+  its shared level queues.
+
+  Must be called before the first job arrives.
+
+  @param s the scheduler instance
+*/
+void sched_use_per_core_queues(scheduler_t *s)
+{
+  if (s->scheduling_scheme == MLFQ || s->run_queues != NULL)
+    return;
+
+  s->run_queues = malloc(sizeof(priqueue_t) * s->total_cores);
+  for (int i = 0; i < s->total_cores; i++)
+    priqueue_init_backend(&s->run_queues[i], job_comparer(s->scheduling_scheme), PRIQUEUE_HEAP);
+}
+
+/**
+  Returns the run queue of core core_id; the shared queue unless per-core
+  queues are enabled.
+*/
+priqueue_t *core_queue(scheduler_t *s, int core_id)
+{
+  return s->run_queues != NULL ? &s->run_queues[core_id] : &s->job_queue;
+}
+
+/**
+  Queues a job that is not tied to a core. With per-core queues it goes to
+  the core with the fewest jobs, counting the one it runs.
+*/
+void enqueue_job(scheduler_t *s, job_t *job)
+{
+  int target = 0;
+
+  if (s->run_queues != NULL)
+  {
+    int best = -1;
+    for (int i = 0; i < s->total_cores; i++)
+    {
+      int load = priqueue_size(&s->run_queues[i]) + !s->core_array[i].is_idle;
+      if (best == -1 || load < best)
+      {
+        best = load;
+        target = i;
+      }
+    }
+  }
+
+  priqueue_offer(core_queue(s, target), job);
+}
+
+/**
+  Returns the lowest numbered idle core, or -1 if every core is busy.
+*/
+int first_idle_core(scheduler_t *s)
+{
+  int words = (s->total_cores + 63) / 64;
+
+  for (int w = 0; w < words; w++)
+    if (s->idle_cores[w] != 0)
+      return w * 64 + __builtin_ctzll(s->idle_cores[w]);
+
+  return -1;
+}
+
+/**
+  Marks core core_id as running job.
+*/
+void core_set(scheduler_t *s, int core_id, job_t *job)
+{
+  s->core_array[core_id].is_idle = 0;
+  s->core_array[core_id].job = job;
+  s->idle_cores[core_id / 64] &= ~(1ULL << (core_id % 64));
+
+  if (s->scheduling_scheme == PSJF || s->scheduling_scheme == PPRI)
+    job->running_handle = priqueue_offer_handle(&s->running, job);
+}
+
+/**
+  Marks core core_id as idle.
+*/
+void core_clear(scheduler_t *s, int core_id)
+{
+  job_t *job = s->core_array[core_id].job;
+
+  if (job != NULL && job->running_handle != -1)
+  {
+    priqueue_remove_handle(&s->running, job->running_handle);
+    job->running_handle = -1;
+  }
+
+  s->core_array[core_id].is_idle = 1;
+  s->core_array[core_id].job = NULL;
+  s->idle_cores[core_id / 64] |= 1ULL << (core_id % 64);
+}
+
+/**
+  Counts a migration if job last ran on a different core.
+*/
+void note_core(scheduler_t *s, job_t *job, int core_id)
+{
+  if (job->last_core != -1 && job->last_core != core_id)
+    s->migrations++;
+  job->last_core = core_id;
+}
+
+/**
+  Puts job on core core_id at time time, recording its first run.
+*/
+void run_job(scheduler_t *s, int core_id, job_t *job, int time)
+{
+  note_core(s, job, core_id);
+  job->slice_start = time;
+  core_set(s, core_id, job);
+  if (job->start_time == -1)
+  {
+    job->start_time = time;
+    job->started = 1;
+  }
+}
+
+/**
+  Appends job to the queue of its MLFQ level.
+*/
+void mlfq_enqueue(scheduler_t *s, job_t *job)
+{
+  priqueue_offer(&s->mlfq_queues[job->level], job);
+}
+
+/**
+  Returns the highest MLFQ level with a waiting job, or MLFQ_LEVELS.
+*/
+int mlfq_top_level(scheduler_t *s)
+{
+  int level = 0;
+  while (level < MLFQ_LEVELS && priqueue_size(&s->mlfq_queues[level]) == 0)
+    level++;
+  return level;
+}
+
+/**
+  Moves every job back to level 0 once the boost period has passed. Jobs
+  keep their order: higher levels first, FIFO within a level.
+*/
+void mlfq_boost(scheduler_t *s, int time)
+{
+  if (time < s->next_boost)
+    return;
+
+  s->next_boost = time - time % MLFQ_BOOST_PERIOD + MLFQ_BOOST_PERIOD;
+
+  for (int level = 1; level < MLFQ_LEVELS; level++)
+  {
+    while (priqueue_size(&s->mlfq_queues[level]) > 0)
+    {
+      job_t *job = (job_t *)priqueue_poll(&s->mlfq_queues[level]);
+      job->level = 0;
+      job->quanta_used = 0;
+      mlfq_enqueue(s, job);
+    }
+  }
+
+  for (int i = 0; i < s->total_cores; i++)
+  {
+    if (s->core_array[i].job != NULL)
+    {
+      s->core_array[i].job->level = 0;
+      s->core_array[i].job->quanta_used = 0;
+    }
+  }
+}
+
+/**
+  Advances min_vruntime to the lowest vruntime of the running jobs and the
+  heads of the run queues. Like Linux's update_min_vruntime() it never
+  moves back, so a job that leaves and returns cannot bring it down.
+*/
+void cfs_update_min_vruntime(scheduler_t *s)
+{
+  long long lowest = -1;
+
+  for (int i = 0; i < s->total_cores; i++)
+  {
+    job_t *job = s->core_array[i].job;
+    if (job != NULL && (lowest == -1 || job->vruntime < lowest))
+      lowest = job->vruntime;
+
+    priqueue_t *queue = core_queue(s, i);
+    job = priqueue_size(queue) > 0 ? (job_t *)priqueue_peek(queue) : NULL;
+    if (job != NULL && (lowest == -1 || job->vruntime < lowest))
+      lowest = job->vruntime;
+  }
+
+  if (lowest > s->min_vruntime)
+    s->min_vruntime = lowest;
+}
+
+/**
+  Charges a CFS job for the time it has run since slice_start. A job's
+  vruntime grows more slowly the higher its weight.
+*/
+void cfs_charge(scheduler_t *s, job_t *job, int time)
+{
+  int priority = job->priority < -20 ? -20 : job->priority > 19 ? 19 : job->priority;
+  long long ran = time - job->slice_start;
+
+  job->vruntime += ran * CFS_NICE_0_WEIGHT * 1024 / cfs_prio_to_weight[priority + 20];
+  job->slice_start = time;
+  cfs_update_min_vruntime(s);
+}
+
+/**
+  Removes and returns the job that should run next on core core_id, or
+  NULL if no job is waiting. With per-core queues an empty queue steals
+  the best job of the longest queue.
+*/
+job_t *next_queued_job(scheduler_t *s, int core_id)
+{
+  if (s->scheduling_scheme == MLFQ)
+  {
+    int level = mlfq_top_level(s);
+    return level < MLFQ_LEVELS ? (job_t *)priqueue_poll(&s->mlfq_queues[level]) : NULL;
+  }
+
+  priqueue_t *queue = core_queue(s, core_id);
+
+  if (priqueue_size(queue) == 0 && s->run_queues != NULL)
+  {
+    for (int i = 0; i < s->total_cores; i++)
+      if (priqueue_size(&s->run_queues[i]) > priqueue_size(queue))
+        queue = &s->run_queues[i];
+  }
+
+  if (priqueue_size(queue) == 0)
+    return NULL;
+
+  return (job_t *)priqueue_poll(queue);
+}
+
+/**
+  MLFQ part of sched_new_job(). New jobs enter level 0 and preempt the
+  running job with the lowest level, if it is below level 0.
+*/
+int mlfq_new_job(scheduler_t *s, job_t *new_job, int time)
+{
+  int victim = -1;
+
+  mlfq_boost(s, time);
+
+  int idle = first_idle_core(s);
+  if (idle != -1)
+  {
+    run_job(s, idle, new_job, time);
+    return idle;
+  }
+
+  for (int i = 0; i < s->total_cores; i++)
+  {
+    if (s->core_array[i].job->level > 0 &&
+        (victim == -1 || s->core_array[i].job->level > s->core_array[victim].job->level))
+      victim = i;
+  }
+
+  if (victim != -1)
+  {
+    mlfq_enqueue(s, s->core_array[victim].job);
+    core_clear(s, victim);
+    run_job(s, victim, new_job, time);
+    return victim;
+  }
+
+  mlfq_enqueue(s, new_job);
+  return -1;
+}
+
+/**
+  MLFQ part of sched_quantum_expired(). The running job keeps its core
+  until it has used its allotment for the level or a job is waiting at a
+  higher level.
+*/
+int mlfq_quantum_expired(scheduler_t *s, int core_id, int time)
+{
+  job_t *job = s->core_array[core_id].job;
+
+  mlfq_boost(s, time);
+
+  if (job != NULL)
+  {
+    if (++job->quanta_used >= (1 << job->level))
+    {
+      if (job->level < MLFQ_LEVELS - 1)
+        job->level++;
+      job->quanta_used = 0;
+      mlfq_enqueue(s, job);
+    }
+    else if (mlfq_top_level(s) < job->level)
+      mlfq_enqueue(s, job);
+    else
+    {
+      job->slice_start = time;
+      return job->job_number;
+    }
+
+    core_clear(s, core_id);
+  }
 
+  job_t *next_job = next_queued_job(s, core_id);
+  if (next_job == NULL)
+    return -1;
+
+  run_job(s, core_id, next_job, time);
+  return next_job->job_number;
+}
+
+/**
+  CFS part of sched_new_job(). The running jobs are charged up to now and
+  the new job starts at min_vruntime, level with the job furthest behind,
+  so it neither owes for nor is credited with time before it arrived. It
+  does not preempt; the next tick on a busy core will pick it if it is
+  behind.
+*/
+int cfs_new_job(scheduler_t *s, job_t *new_job, int time)
+{
+  for (int i = 0; i < s->total_cores; i++)
+    if (s->core_array[i].job != NULL)
+      cfs_charge(s, s->core_array[i].job, time);
+  cfs_update_min_vruntime(s);
+  new_job->vruntime = s->min_vruntime;
+
+  int idle = first_idle_core(s);
+  if (idle != -1)
+  {
+    run_job(s, idle, new_job, time);
+    return idle;
+  }
+
+  enqueue_job(s, new_job);
+  return -1;
+}
+
+/**
+  CFS part of sched_quantum_expired(). The running job is charged for its
+  slice and gives up the core only if a waiting job has run less.
+*/
+int cfs_quantum_expired(scheduler_t *s, int core_id, int time)
+{
+  job_t *job = s->core_array[core_id].job;
+
+  if (job != NULL)
+  {
+    cfs_charge(s, job, time);
+
+    priqueue_t *queue = core_queue(s, core_id);
+    job_t *waiting = priqueue_size(queue) > 0 ? (job_t *)priqueue_peek(queue) : NULL;
+    if (waiting == NULL || waiting->vruntime >= job->vruntime)
+      return job->job_number;
+
+    priqueue_offer(queue, job);
+    core_clear(s, core_id);
+  }
+
+  job_t *next_job = next_queued_job(s, core_id);
+  if (next_job == NULL)
+    return -1;
+
+  run_job(s, core_id, next_job, time);
+  return next_job->job_number;
+}
+
+/*
+  The decision behind sched_new_job().
  */
-int scheduler_new_job(int job_number, int time, int running_time, int priority)
+static int decide_new_job(scheduler_t *s, int job_number, int time, int running_time, int priority)
 {
   job_t *new_job = (job_t *)malloc(sizeof(job_t));
   *new_job = (job_t){
@@ -151,95 +654,116 @@ int scheduler_new_job(int job_number, int time, int running_time, int priority)
       .priority = priority,
       .start_time = -1,
       .end_time = 0,
-      .started = 0};
+      .started = 0,
+      .level = 0,
+      .quanta_used = 0,
+      .vruntime = 0,
+      .slice_start = time,
+      .last_core = -1,
+      .running_handle = -1};
 
-  for (int i = 0; i < total_cores; i++)
+  if (s->scheduling_scheme == MLFQ)
+    return mlfq_new_job(s, new_job, time);
+  if (s->scheduling_scheme == CFS)
+    return cfs_new_job(s, new_job, time);
+
+  int idle = first_idle_core(s);
+  if (idle != -1)
   {
-    if (core_array[i].is_idle)
-    {
-      core_array[i].is_idle = 0;
-      core_array[i].job = new_job;
-      new_job->start_time = time;
-      new_job->started = 1;
-      return i;
-    }
+    run_job(s, idle, new_job, time);
+    return idle;
   }
 
+  // The running job that is the worst fit is the only candidate
   int preempt_core_id = -1;
-  for (int i = 0; i < total_cores; i++)
+  if ((s->scheduling_scheme == PSJF || s->scheduling_scheme == PPRI) && priqueue_size(&s->running) > 0)
   {
-    job_t *current_job = core_array[i].job;
-    if (current_job != NULL && ((scheduling_scheme == PPRI && priority < current_job->priority) ||
-                                (scheduling_scheme == PSJF && running_time < current_job->remaining_time)))
-    {
-      preempt_core_id = i;
-      break;
-    }
+    job_t *victim = (job_t *)priqueue_peek(&s->running);
+    if ((s->scheduling_scheme == PPRI && priority < victim->priority) ||
+        (s->scheduling_scheme == PSJF && running_time < victim->remaining_time - (time - victim->slice_start)))
+      preempt_core_id = victim->last_core;
   }
 
   if (preempt_core_id != -1)
   {
-    job_t *preempted_job = core_array[preempt_core_id].job;
-    preempted_job->remaining_time -= (time - preempted_job->start_time);
-    priqueue_offer(&job_queue, preempted_job);
+    job_t *preempted_job = s->core_array[preempt_core_id].job;
+    preempted_job->remaining_time -= (time - preempted_job->slice_start);
+    core_clear(s, preempt_core_id);
+    priqueue_offer(core_queue(s, preempt_core_id), preempted_job);
 
-    core_array[preempt_core_id].job = new_job;
-    new_job->start_time = time;
-    new_job->started = 1;
+    run_job(s, preempt_core_id, new_job, time);
     return preempt_core_id;
   }
 
-  priqueue_offer(&job_queue, new_job);
+  enqueue_job(s, new_job);
   return -1; // Job is queued
 }
 
 /**
-  Called when a job has completed execution.
+  Called when a new job arrives.
 
-  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
-  If any job should be scheduled to run on the core free'd up by the
-  finished job, return the job_number of the job that should be scheduled to
-  run on core core_id.
+  If multiple cores are idle, the job should be assigned to the core with the
+  lowest id.
+  If the job arriving should be scheduled to run during the next
+  time cycle, return the zero-based index of the core the job should be
+  scheduled on. If another job is already running on the core specified,
+  this will preempt the currently running job.
+  Assumption:
+    - You may assume that every job wil have a unique arrival time.
 
-  @param core_id the zero-based index of the core where the job was located.
-  @param job_number a globally unique identification number of the job.
+  @param s the scheduler instance
+  @param job_number a globally unique identification number of the job arriving.
   @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled to run on core core_id
-  @return -1 if core should remain idle.
+  @param running_time the total number of time units this job will run before it will be finished.
+  @param priority the priority of the job. (The lower the value, the higher the priority.)
+  @return index of core job should be scheduled on
+  @return -1 if no scheduling changes should be made.
+
  */
-int scheduler_job_finished(int core_id, int job_number, int time)
+int sched_new_job(scheduler_t *s, int job_number, int time, int running_time, int priority)
 {
-  if (!core_array[core_id].is_idle && core_array[core_id].job)
+  int core_id = decide_new_job(s, job_number, time, running_time, priority);
+
+  if (s->log != NULL)
+    schedlog_write(s->log, &(schedlog_event_t){SCHEDLOG_NEW_JOB, -1, job_number, time, running_time, priority, core_id});
+  return core_id;
+}
+
+/*
+  The decision behind sched_job_finished().
+ */
+static int decide_job_finished(scheduler_t *s, int core_id, int job_number, int time)
+{
+  if (!s->core_array[core_id].is_idle && s->core_array[core_id].job)
   {
-    job_t *finished_job = core_array[core_id].job;
+    job_t *finished_job = s->core_array[core_id].job;
     finished_job->end_time = time;
     int waiting_time = finished_job->end_time - finished_job->arrival_time - finished_job->running_time;
     int turnaround_time = finished_job->end_time - finished_job->arrival_time;
     int response_time = finished_job->start_time - finished_job->arrival_time;
 
-    total_waiting_time += waiting_time;
-    total_turnaround_time += turnaround_time;
+    s->total_waiting_time += waiting_time;
+    s->total_turnaround_time += turnaround_time;
+    histogram_record(&s->waiting_times, waiting_time);
+    histogram_record(&s->turnaround_times, turnaround_time);
     if (finished_job->started)
     {
-      total_response_time += response_time;
-      total_jobs_completed++;
+      s->total_response_time += response_time;
+      histogram_record(&s->response_times, response_time);
+      s->total_jobs_completed++;
     }
 
+    core_clear(s, core_id);
     free(finished_job);
-    core_array[core_id].is_idle = 1;
-    core_array[core_id].job = NULL;
   }
 
-  if (priqueue_size(&job_queue) > 0)
+  if (s->scheduling_scheme == MLFQ)
+    mlfq_boost(s, time);
+
+  job_t *next_job = next_queued_job(s, core_id);
+  if (next_job != NULL)
   {
-    job_t *next_job = (job_t *)priqueue_poll(&job_queue);
-    core_array[core_id].is_idle = 0;
-    core_array[core_id].job = next_job;
-    if (next_job->start_time == -1)
-    {
-      next_job->start_time = time;
-      next_job->started = 1;
-    }
+    run_job(s, core_id, next_job, time);
     return next_job->job_number;
   }
 
@@ -247,55 +771,94 @@ int scheduler_job_finished(int core_id, int job_number, int time)
 }
 
 /**
-  When the scheme is set to RR, called when the quantum timer has expired
-  on a core.
+  Called when a job has completed execution.
 
-  If any job should be scheduled to run on the core free'd up by
-  the quantum expiration, return the job_number of the job that should be
-  scheduled to run on core core_id.
+  The core_id, job_number and time parameters are provided for convenience. You may be able to calculate the values with your own data structure.
+  If any job should be scheduled to run on the core free'd up by the
+  finished job, return the job_number of the job that should be scheduled to
+  run on core core_id.
 
-  @param core_id the zero-based index of the core where the quantum has expired.
+  @param s the scheduler instance
+  @param core_id the zero-based index of the core where the job was located.
+  @param job_number a globally unique identification number of the job.
   @param time the current time of the simulator.
-  @return job_number of the job that should be scheduled on core cord_id
-  @return -1 if core should remain idle
+  @return job_number of the job that should be scheduled to run on core core_id
+  @return -1 if core should remain idle.
  */
-int scheduler_quantum_expired(int core_id, int time)
+int sched_job_finished(scheduler_t *s, int core_id, int job_number, int time)
+{
+  int next = decide_job_finished(s, core_id, job_number, time);
+
+  if (s->log != NULL)
+    schedlog_write(s->log, &(schedlog_event_t){SCHEDLOG_JOB_FINISHED, core_id, job_number, time, -1, -1, next});
+  return next;
+}
+
+/*
+  The decision behind sched_quantum_expired().
+ */
+static int decide_quantum_expired(scheduler_t *s, int core_id, int time)
 {
-  if (core_array[core_id].is_idle == 0)
+  if (s->scheduling_scheme == MLFQ)
+    return mlfq_quantum_expired(s, core_id, time);
+  if (s->scheduling_scheme == CFS)
+    return cfs_quantum_expired(s, core_id, time);
+
+  if (s->core_array[core_id].is_idle == 0)
   {
-    job_t *current_job = core_array[core_id].job;
-    priqueue_offer(&job_queue, current_job);
-    core_array[core_id].job = NULL;
-    core_array[core_id].is_idle = 1;
+    job_t *current_job = s->core_array[core_id].job;
+    priqueue_offer(core_queue(s, core_id), current_job);
+    core_clear(s, core_id);
   }
 
-  if (priqueue_size(&job_queue) > 0)
+  job_t *next_job = next_queued_job(s, core_id);
+  if (next_job != NULL)
   {
-    job_t *next_job = (job_t *)priqueue_poll(&job_queue);
-    core_array[core_id].is_idle = 0;
-    core_array[core_id].job = next_job;
-    if (next_job->start_time == -1)
-    {
-      next_job->start_time = time;
-    }
+    run_job(s, core_id, next_job, time);
     return next_job->job_number;
   }
 
   return -1; // No job scheduled
 }
 
+/**
+  When the scheme is set to RR, MLFQ or CFS, called when the quantum timer
+  has expired on a core. MLFQ and CFS may return the job already running on
+  the core to let it continue.
+
+  If any job should be scheduled to run on the core free'd up by
+  the quantum expiration, return the job_number of the job that should be
+  scheduled to run on core core_id.
+
+  @param s the scheduler instance
+  @param core_id the zero-based index of the core where the quantum has expired.
+  @param time the current time of the simulator.
+  @return job_number of the job that should be scheduled on core cord_id
+  @return -1 if core should remain idle
+ */
+int sched_quantum_expired(scheduler_t *s, int core_id, int time)
+{
+  int next = decide_quantum_expired(s, core_id, time);
+
+  if (s->log != NULL)
+    schedlog_write(s->log, &(schedlog_event_t){SCHEDLOG_QUANTUM_EXPIRED, core_id, -1, time, -1, -1, next});
+  return next;
+}
+
 /**
   Returns the average waiting time of all jobs scheduled by your scheduler.
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+
+  @param s the scheduler instance
   @return the average waiting time of all jobs scheduled.
  */
-float scheduler_average_waiting_time()
+float sched_average_waiting_time(scheduler_t *s)
 {
-  if (total_jobs_completed == 0)
+  if (s->total_jobs_completed == 0)
     return 0.0;
-  return total_waiting_time / total_jobs_completed;
+  return s->total_waiting_time / s->total_jobs_completed;
 }
 
 /**
@@ -303,13 +866,15 @@ float scheduler_average_waiting_time()
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+
+  @param s the scheduler instance
   @return the average turnaround time of all jobs scheduled.
  */
-float scheduler_average_turnaround_time()
+float sched_average_turnaround_time(scheduler_t *s)
 {
-  if (total_jobs_completed == 0)
+  if (s->total_jobs_completed == 0)
     return 0;
-  return total_turnaround_time / total_jobs_completed;
+  return s->total_turnaround_time / s->total_jobs_completed;
 }
 
 /**
@@ -317,13 +882,86 @@ float scheduler_average_turnaround_time()
 
   Assumptions:
     - This function will only be called after all scheduling is complete (all jobs that have arrived will have finished and no new jobs will arrive).
+
+  @param s the scheduler instance
   @return the average response time of all jobs scheduled.
  */
-float scheduler_average_response_time()
+float sched_average_response_time(scheduler_t *s)
 {
-  if (total_jobs_completed == 0)
+  if (s->total_jobs_completed == 0)
     return 0.0;
-  return total_response_time / total_jobs_completed;
+  return s->total_response_time / s->total_jobs_completed;
+}
+
+/**
+  Returns the waiting time that percentile percent of the finished jobs
+  did not exceed, within about 3%.
+
+  @param s the scheduler instance
+  @param percentile a percentage from 0 to 100, e.g. 50, 99 or 99.9; 100 gives the maximum
+  @return the waiting time at the percentile
+ */
+int sched_waiting_time_percentile(scheduler_t *s, double percentile)
+{
+  return histogram_percentile(&s->waiting_times, percentile);
+}
+
+/**
+  Returns the turnaround time that percentile percent of the finished jobs
+  did not exceed, within about 3%.
+
+  @param s the scheduler instance
+  @param percentile a percentage from 0 to 100; 100 gives the maximum
+  @return the turnaround time at the percentile
+ */
+int sched_turnaround_time_percentile(scheduler_t *s, double percentile)
+{
+  return histogram_percentile(&s->turnaround_times, percentile);
+}
+
+/**
+  Returns the response time that percentile percent of the finished jobs
+  did not exceed, within about 3%.
+
+  @param s the scheduler instance
+  @param percentile a percentage from 0 to 100; 100 gives the maximum
+  @return the response time at the percentile
+ */
+int sched_response_time_percentile(scheduler_t *s, double percentile)
+{
+  return histogram_percentile(&s->response_times, percentile);
+}
+
+/**
+  Returns how many times a job resumed on a different core than the one it
+  last ran on.
+
+  @param s the scheduler instance
+  @return the number of migrations so far
+ */
+int sched_migrations(scheduler_t *s)
+{
+  return s->migrations;
+}
+
+/**
+  Records every call to sched_new_job(), sched_job_finished() and
+  sched_quantum_expired() from now on, with its result, in a binary log
+  (see schedlog.h) that ./replay can run again without the simulator.
+  Call it after sched_use_per_core_queues(), before the first job arrives.
+  The log is closed by scheduler_destroy().
+
+  @param s the scheduler instance
+  @param file_name the path of the log
+  @return 0 on success, -1 if the file cannot be created
+*/
+int sched_record(scheduler_t *s, const char *file_name)
+{
+  if (s->log != NULL)
+    schedlog_close(s->log);
+
+  s->log = schedlog_create(file_name, s->total_cores, s->scheduling_scheme, s->run_queues != NULL);
+  return s->log != NULL ? 0 : -1;
 }
 
 /**
@@ -331,17 +969,50 @@ float scheduler_average_response_time()
 
   Assumption:
     - This function will be the last function called in your library.
+
+  @param s the scheduler instance
 */
-void scheduler_clean_up()
+void scheduler_destroy(scheduler_t *s)
 {
-  while (priqueue_size(&job_queue) > 0)
+  while (priqueue_size(&s->job_queue) > 0)
   {
-    job_t *job = (job_t *)priqueue_poll(&job_queue);
+    job_t *job = (job_t *)priqueue_poll(&s->job_queue);
     free(job);
   }
 
-  priqueue_destroy(&job_queue);
-  free(core_array);
+  for (int i = 0; i < s->total_cores; i++)
+    free(s->core_array[i].job);
+
+  if (s->scheduling_scheme == MLFQ)
+  {
+    for (int i = 0; i < MLFQ_LEVELS; i++)
+    {
+      while (priqueue_size(&s->mlfq_queues[i]) > 0)
+        free(priqueue_poll(&s->mlfq_queues[i]));
+      priqueue_destroy(&s->mlfq_queues[i]);
+    }
+  }
+
+  if (s->run_queues != NULL)
+  {
+    for (int i = 0; i < s->total_cores; i++)
+    {
+      while (priqueue_size(&s->run_queues[i]) > 0)
+        free(priqueue_poll(&s->run_queues[i]));
+      priqueue_destroy(&s->run_queues[i]);
+    }
+    free(s->run_queues);
+  }
+
+  if (s->log != NULL)
+    schedlog_close(s->log);
+
+  priqueue_destroy(&s->job_queue);
+  if (s->scheduling_scheme == PSJF || s->scheduling_scheme == PPRI)
+    priqueue_destroy(&s->running);
+  free(s->idle_cores);
+  free(s->core_array);
+  free(s);
 }
 
 /**
@@ -354,7 +1025,99 @@ void scheduler_clean_up()
 
   This function is not required and will not be graded. You may leave it
   blank if you do not find it useful.
+
+  @param s the scheduler instance
  */
+void sched_show_queue(scheduler_t *s)
+{
+}
+
+/*
+  The scheduler_* functions below are the interface used by the simulator.
+  Each one forwards to the instance created by scheduler_start_up().
+ */
+
+/** Calls sched_new_job() on the default scheduler. */
+int scheduler_new_job(int job_number, int time, int running_time, int priority)
+{
+  return sched_new_job(default_scheduler, job_number, time, running_time, priority);
+}
+
+/** Calls sched_job_finished() on the default scheduler. */
+int scheduler_job_finished(int core_id, int job_number, int time)
+{
+  return sched_job_finished(default_scheduler, core_id, job_number, time);
+}
+
+/** Calls sched_quantum_expired() on the default scheduler. */
+int scheduler_quantum_expired(int core_id, int time)
+{
+  return sched_quantum_expired(default_scheduler, core_id, time);
+}
+
+/** Calls sched_average_waiting_time() on the default scheduler. */
+float scheduler_average_waiting_time()
+{
+  return sched_average_waiting_time(default_scheduler);
+}
+
+/** Calls sched_average_turnaround_time() on the default scheduler. */
+float scheduler_average_turnaround_time()
+{
+  return sched_average_turnaround_time(default_scheduler);
+}
+
+/** Calls sched_average_response_time() on the default scheduler. */
+float scheduler_average_response_time()
+{
+  return sched_average_response_time(default_scheduler);
+}
+
+/** Calls sched_waiting_time_percentile() on the default scheduler. */
+int scheduler_waiting_time_percentile(double percentile)
+{
+  return sched_waiting_time_percentile(default_scheduler, percentile);
+}
+
+/** Calls sched_turnaround_time_percentile() on the default scheduler. */
+int scheduler_turnaround_time_percentile(double percentile)
+{
+  return sched_turnaround_time_percentile(default_scheduler, percentile);
+}
+
+/** Calls sched_response_time_percentile() on the default scheduler. */
+int scheduler_response_time_percentile(double percentile)
+{
+  return sched_response_time_percentile(default_scheduler, percentile);
+}
+
+/** Calls sched_use_per_core_queues() on the default scheduler. */
+void scheduler_use_per_core_queues()
+{
+  sched_use_per_core_queues(default_scheduler);
+}
+
+/** Calls sched_migrations() on the default scheduler. */
+int scheduler_migrations()
+{
+  return sched_migrations(default_scheduler);
+}
+
+/** Calls sched_record() on the default scheduler. */
+int scheduler_record(const char *file_name)
+{
+  return sched_record(default_scheduler, file_name);
+}
+
+/** Destroys the default scheduler. */
+void scheduler_clean_up()
+{
+  scheduler_destroy(default_scheduler);
+  default_scheduler = NULL;
+}
+
+/** Calls sched_show_queue() on the default scheduler. */
 void scheduler_show_queue()
 {
+  sched_show_queue(default_scheduler);
 }
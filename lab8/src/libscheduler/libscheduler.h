@@ -5,9 +5,13 @@
 #define LIBSCHEDULER_H_
 
 /**
-  Constants which represent the different scheduling algorithms
+  Constants which represent the different scheduling algorithms. MLFQ is a
+  multi-level feedback queue and CFS orders jobs by weighted virtual run
+  time; both are driven by the quantum timer like RR.
 */
-typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR} scheme_t;
+typedef enum {FCFS = 0, SJF, PSJF, PRI, PPRI, RR, MLFQ, CFS} scheme_t;
+
+int   scheduler_uses_quantum           (scheme_t scheme);
 
 void  scheduler_start_up               (int cores, scheme_t scheme);
 int   scheduler_new_job                (int job_number, int time, int running_time, int priority);
@@ -16,8 +20,39 @@ int   scheduler_quantum_expired        (int core_id, int time);
 float scheduler_average_turnaround_time();
 float scheduler_average_waiting_time   ();
 float scheduler_average_response_time  ();
+int   scheduler_waiting_time_percentile   (double percentile);
+int   scheduler_turnaround_time_percentile(double percentile);
+int   scheduler_response_time_percentile  (double percentile);
 void  scheduler_clean_up               ();
 
+void  scheduler_use_per_core_queues    ();
+int   scheduler_migrations             ();
+int   scheduler_record                 (const char *file_name);
+
 void  scheduler_show_queue             ();
 
+/**
+  An independent scheduler instance. The scheduler_* functions above drive
+  a single default instance; the functions below take the instance
+  explicitly, so any number can run side by side (one per thread at most).
+*/
+typedef struct _scheduler_t scheduler_t;
+
+scheduler_t *scheduler_create          (int cores, scheme_t scheme);
+int   sched_new_job                    (scheduler_t *s, int job_number, int time, int running_time, int priority);
+int   sched_job_finished               (scheduler_t *s, int core_id, int job_number, int time);
+int   sched_quantum_expired            (scheduler_t *s, int core_id, int time);
+float sched_average_turnaround_time    (scheduler_t *s);
+float sched_average_waiting_time       (scheduler_t *s);
+float sched_average_response_time      (scheduler_t *s);
+int   sched_waiting_time_percentile    (scheduler_t *s, double percentile);
+int   sched_turnaround_time_percentile (scheduler_t *s, double percentile);
+int   sched_response_time_percentile   (scheduler_t *s, double percentile);
+void  sched_use_per_core_queues        (scheduler_t *s);
+int   sched_migrations                 (scheduler_t *s);
+int   sched_record                     (scheduler_t *s, const char *file_name);
+void  scheduler_destroy                (scheduler_t *s);
+
+void  sched_show_queue                 (scheduler_t *s);
+
 #endif /* LIBSCHEDULER_H_ */
@@ -0,0 +1,167 @@
+/** @file schedlog.c
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "schedlog.h"
+
+static void put_varint(FILE *file, long long value)
+{
+  // Zigzag, so that small negative numbers (-1) stay one byte
+  uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+
+  while (v >= 0x80)
+  {
+    putc_unlocked((int)(v & 0x7f) | 0x80, file);
+    v >>= 7;
+  }
+  putc_unlocked((int)v, file);
+}
+
+/*
+  Returns 0 at the end of the file or if a varint is cut short.
+ */
+static int get_varint(FILE *file, long long *value)
+{
+  uint64_t v = 0;
+  int shift = 0, c;
+
+  do
+  {
+    if ((c = getc_unlocked(file)) == EOF || shift > 63)
+      return 0;
+    v |= (uint64_t)(c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+
+  *value = (long long)(v >> 1) ^ -(long long)(v & 1);
+  return 1;
+}
+
+/**
+  Creates a log and writes its header.
+
+  @param file_name the path of the log
+  @param cores the number of cores of the scheduler being recorded
+  @param scheme the scheme of the scheduler being recorded
+  @param per_core non-zero if it uses per-core run queues
+  @return the log, or NULL if the file cannot be created
+*/
+schedlog_t *schedlog_create(const char *file_name, int cores, scheme_t scheme, int per_core)
+{
+  FILE *file = fopen(file_name, "wb");
+  if (file == NULL)
+    return NULL;
+
+  schedlog_t *log = malloc(sizeof(schedlog_t));
+  *log = (schedlog_t){.file = file, .last_time = 0, .cores = cores, .scheme = scheme, .per_core = per_core};
+
+  fwrite(SCHEDLOG_MAGIC, 1, 8, file);
+  put_varint(file, cores);
+  put_varint(file, scheme);
+  put_varint(file, per_core);
+
+  return log;
+}
+
+/**
+  Appends one call to the log.
+
+  @param log a log from schedlog_create()
+  @param event the call and its result
+*/
+void schedlog_write(schedlog_t *log, const schedlog_event_t *event)
+{
+  putc_unlocked(event->kind, log->file);
+  put_varint(log->file, (long long)event->time - log->last_time);
+  log->last_time = event->time;
+
+  if (event->kind != SCHEDLOG_NEW_JOB)
+    put_varint(log->file, event->core_id);
+  if (event->kind != SCHEDLOG_QUANTUM_EXPIRED)
+    put_varint(log->file, event->job_number);
+  if (event->kind == SCHEDLOG_NEW_JOB)
+  {
+    put_varint(log->file, event->running_time);
+    put_varint(log->file, event->priority);
+  }
+  put_varint(log->file, event->result);
+}
+
+/**
+  Opens a log for reading and reads its header into the cores, scheme and
+  per_core fields.
+
+  @param file_name the path of the log, or "-" for stdin
+  @return the log, or NULL if the file cannot be opened or is not a log
+*/
+schedlog_t *schedlog_open(const char *file_name)
+{
+  FILE *file = strcmp(file_name, "-") == 0 ? stdin : fopen(file_name, "rb");
+  char magic[8];
+  long long cores, scheme, per_core;
+
+  if (file == NULL)
+    return NULL;
+
+  if (fread(magic, 1, 8, file) != 8 || memcmp(magic, SCHEDLOG_MAGIC, 8) != 0 ||
+      !get_varint(file, &cores) || !get_varint(file, &scheme) || !get_varint(file, &per_core) ||
+      cores <= 0 || scheme < FCFS || scheme > CFS)
+  {
+    if (file != stdin)
+      fclose(file);
+    return NULL;
+  }
+
+  schedlog_t *log = malloc(sizeof(schedlog_t));
+  *log = (schedlog_t){.file = file, .last_time = 0, .cores = (int)cores, .scheme = (scheme_t)scheme, .per_core = (int)per_core};
+  return log;
+}
+
+/**
+  Reads the next call.
+
+  @param log a log from schedlog_open()
+  @param event filled in with the call
+  @return 1 if a call was read
+  @return 0 at the end of the log
+  @return -1 if the log is malformed or truncated
+*/
+int schedlog_read(schedlog_t *log, schedlog_event_t *event)
+{
+  long long delta, core_id = -1, job_number = -1, running_time = -1, priority = -1, result;
+  int kind = getc_unlocked(log->file);
+
+  if (kind == EOF)
+    return 0;
+  if (kind < SCHEDLOG_NEW_JOB || kind > SCHEDLOG_QUANTUM_EXPIRED || !get_varint(log->file, &delta))
+    return -1;
+
+  if (kind != SCHEDLOG_NEW_JOB && !get_varint(log->file, &core_id))
+    return -1;
+  if (kind != SCHEDLOG_QUANTUM_EXPIRED && !get_varint(log->file, &job_number))
+    return -1;
+  if (kind == SCHEDLOG_NEW_JOB && (!get_varint(log->file, &running_time) || !get_varint(log->file, &priority)))
+    return -1;
+  if (!get_varint(log->file, &result))
+    return -1;
+
+  log->last_time += (int)delta;
+  *event = (schedlog_event_t){.kind = (schedlog_kind_t)kind, .core_id = (int)core_id, .job_number = (int)job_number,
+      .time = log->last_time, .running_time = (int)running_time, .priority = (int)priority, .result = (int)result};
+  return 1;
+}
+
+/**
+  Flushes and closes a log.
+
+  @param log a log from schedlog_create() or schedlog_open()
+*/
+void schedlog_close(schedlog_t *log)
+{
+  if (log->file != stdin)
+    fclose(log->file);
+  free(log);
+}
@@ -0,0 +1,51 @@
+/** @file schedlog.h
+ */
+
+#ifndef SCHEDLOG_H_
+#define SCHEDLOG_H_
+
+#include <stdio.h>
+
+#include "libscheduler.h"
+
+/**
+  A scheduler log starts with SCHEDLOG_MAGIC and a header (cores, scheme,
+  per-core queues). Each call is then one kind byte followed by its
+  arguments and result as zigzag varints; times are stored as the change
+  from the previous call, so most calls take five to eight bytes.
+*/
+#define SCHEDLOG_MAGIC "SCHEDLG1"
+
+typedef enum {SCHEDLOG_NEW_JOB = 1, SCHEDLOG_JOB_FINISHED, SCHEDLOG_QUANTUM_EXPIRED} schedlog_kind_t;
+
+/**
+  One recorded call. Fields a call does not take are -1: core_id for
+  new jobs, job_number, running_time and priority for quantum expiry.
+*/
+typedef struct
+{
+  schedlog_kind_t kind;
+  int core_id;
+  int job_number;
+  int time;
+  int running_time;
+  int priority;
+  int result;
+} schedlog_event_t;
+
+typedef struct
+{
+  FILE *file;
+  int last_time;
+  int cores;
+  scheme_t scheme;
+  int per_core;
+} schedlog_t;
+
+schedlog_t *schedlog_create(const char *file_name, int cores, scheme_t scheme, int per_core);
+void        schedlog_write (schedlog_t *log, const schedlog_event_t *event);
+schedlog_t *schedlog_open  (const char *file_name);
+int         schedlog_read  (schedlog_t *log, schedlog_event_t *event);
+void        schedlog_close (schedlog_t *log);
+
+#endif /* SCHEDLOG_H_ */
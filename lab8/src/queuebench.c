@@ -0,0 +1,311 @@
+/** @file queuebench.c
+ *
+ * Micro-benchmarks for priqueue_t. For every size and key order (random,
+ * sorted, reverse) each backend is timed on offer, peek, poll, remove and
+ * remove_at.
+ *
+ * Usage: ./queuebench [-l list_limit] [size ...]
+ *
+ * ns/op is the mean over a batch of operations timed as a whole. p50, p99
+ * and max come from a second run that times every operation on its own, so
+ * they include the cost of reading the clock (a few tens of ns). allocs/op
+ * counts the allocations made by the queue.
+ *
+ * remove and remove_at are O(n) or worse on both backends. They are timed
+ * on a full queue for about REMOVE_BUDGET / size operations, at least
+ * REMOVE_MIN and at most REMOVE_MAX.
+ *
+ * Backends:
+ *   list   the sorted linked list
+ *   pool   the list with its node pool sized for N up front
+ *   heap   the binary heap; "build" is priqueue_init_from_array()
+ *   typed  a PRIQUEUE_DEFINE specialization with an inlined comparison
+ *
+ * The list is quadratic to fill, so it is skipped above a size limit:
+ * LIST_LIMIT elements unless -l gives another. At the default it still
+ * runs at 100000, which takes several minutes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/priqueue_define.h"
+#include "libscheduler/histogram.h"
+
+#define LIST_LIMIT 100000
+#define REMOVE_BUDGET 5000000
+#define REMOVE_MIN 10
+#define REMOVE_MAX 200
+
+typedef enum { KEYS_RANDOM = 0, KEYS_SORTED, KEYS_REVERSE } key_order_t;
+
+const char *order_names[] = { "random", "sorted", "reverse" };
+
+int compare_int(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+#define INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+PRIQUEUE_DEFINE(intq, int, INT_CMP)
+
+double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Prints one result row. A NULL latency means it was not measured, and
+ * allocs < 0 means the backend does not count them.
+ */
+void report(const char *backend, key_order_t order, int n, const char *op, double ns_per_op,
+		histogram_t *latency, int ops, double allocs)
+{
+	printf("%-6s %-8s %8d %-10s %12.1f", backend, order_names[order], n, op, ns_per_op);
+	if (latency != NULL)
+		printf(" %10d %10d %10d", histogram_percentile(latency, 50), histogram_percentile(latency, 99),
+				histogram_percentile(latency, 100));
+	else
+		printf(" %10s %10s %10s", "-", "-", "-");
+	if (allocs >= 0)
+		printf(" %10.3f\n", allocs / ops);
+	else
+		printf(" %10s\n", "-");
+}
+
+/*
+ * Times a single operation into a latency histogram.
+ */
+#define TIME_ONE(hist, stmt)                           \
+	do                                                 \
+	{                                                  \
+		double t0_ = now_ns();                         \
+		stmt;                                          \
+		histogram_record(hist, (int)(now_ns() - t0_)); \
+	} while (0)
+
+void queue_init(priqueue_t *q, priqueue_backend_t backend, int pooled, int n)
+{
+	if (pooled)
+		priqueue_init_pool(q, compare_int, backend, n);
+	else
+		priqueue_init_backend(q, compare_int, backend);
+}
+
+void bench(const char *name, priqueue_backend_t backend, int pooled, int *keys, int n, key_order_t order)
+{
+	priqueue_t q;
+	histogram_t offer_lat, peek_lat, poll_lat, remove_lat, remove_at_lat;
+	volatile void *sink;
+	int i, ops = REMOVE_BUDGET / n;
+
+	if (ops < REMOVE_MIN)
+		ops = REMOVE_MIN;
+	if (ops > REMOVE_MAX)
+		ops = REMOVE_MAX;
+	if (ops > n)
+		ops = n;
+
+	histogram_init(&offer_lat);
+	histogram_init(&peek_lat);
+	histogram_init(&poll_lat);
+	histogram_init(&remove_lat);
+	histogram_init(&remove_at_lat);
+
+	/*
+	 * Throughput: offer, peek and poll, each as one timed batch.
+	 */
+	queue_init(&q, backend, pooled, n);
+
+	double start = now_ns();
+	for (i = 0; i < n; i++)
+		priqueue_offer(&q, &keys[i]);
+	double offered = now_ns();
+	unsigned long offer_allocs = priqueue_alloc_count(&q);
+
+	for (i = 0; i < n; i++)
+		sink = priqueue_peek(&q);
+	double peeked = now_ns();
+
+	int last = -1, sorted = 1;
+	for (i = 0; i < n; i++)
+	{
+		int key = *(int *)priqueue_poll(&q);
+		if (key < last)
+			sorted = 0;
+		last = key;
+	}
+	double polled = now_ns();
+	unsigned long poll_allocs = priqueue_alloc_count(&q) - offer_allocs;
+
+	priqueue_destroy(&q);
+
+	/*
+	 * Latency: the same operations, each timed on its own.
+	 */
+	queue_init(&q, backend, pooled, n);
+	for (i = 0; i < n; i++)
+		TIME_ONE(&offer_lat, priqueue_offer(&q, &keys[i]));
+	for (i = 0; i < n; i++)
+		TIME_ONE(&peek_lat, sink = priqueue_peek(&q));
+	for (i = 0; i < n; i++)
+		TIME_ONE(&poll_lat, sink = priqueue_poll(&q));
+	priqueue_destroy(&q);
+
+	/*
+	 * remove and remove_at on a full queue.
+	 */
+	queue_init(&q, backend, pooled, n);
+	for (i = 0; i < n; i++)
+		priqueue_offer(&q, &keys[i]);
+
+	unsigned long before = priqueue_alloc_count(&q);
+	double remove_start = now_ns();
+	for (i = 0; i < ops; i++)
+		TIME_ONE(&remove_lat, priqueue_remove(&q, &keys[(long long)i * n / ops]));
+	double removed = now_ns();
+	unsigned long remove_allocs = priqueue_alloc_count(&q) - before;
+
+	before = priqueue_alloc_count(&q);
+	double remove_at_start = now_ns();
+	for (i = 0; i < ops && priqueue_size(&q) > 0; i++)
+		TIME_ONE(&remove_at_lat, sink = priqueue_remove_at(&q, rand() % priqueue_size(&q)));
+	double removed_at = now_ns();
+	unsigned long remove_at_allocs = priqueue_alloc_count(&q) - before;
+
+	priqueue_destroy(&q);
+	(void)sink;
+
+	report(name, order, n, "offer", (offered - start) / n, &offer_lat, n, offer_allocs);
+	report(name, order, n, "peek", (peeked - offered) / n, &peek_lat, n, 0);
+	report(name, order, n, sorted ? "poll" : "poll(BAD)", (polled - peeked) / n, &poll_lat, n, poll_allocs);
+	report(name, order, n, "remove", (removed - remove_start) / ops, &remove_lat, ops, remove_allocs);
+	report(name, order, n, "remove_at", (removed_at - remove_at_start) / ops, &remove_at_lat, ops, remove_at_allocs);
+}
+
+void bench_bulk(int *keys, int n, key_order_t order)
+{
+	priqueue_t q;
+	int i;
+
+	void **items = malloc(n * sizeof(void *));
+	for (i = 0; i < n; i++)
+		items[i] = &keys[i];
+
+	double start = now_ns();
+	priqueue_init_from_array(&q, compare_int, PRIQUEUE_HEAP, items, n);
+	double built = now_ns();
+
+	report("heap", order, n, "build", (built - start) / n, NULL, n, priqueue_alloc_count(&q));
+
+	priqueue_destroy(&q);
+	free(items);
+}
+
+void bench_specialized(int *keys, int n, key_order_t order)
+{
+	intq_t q;
+	histogram_t offer_lat, peek_lat, poll_lat;
+	int i;
+
+	histogram_init(&offer_lat);
+	histogram_init(&peek_lat);
+	histogram_init(&poll_lat);
+
+	intq_init(&q);
+
+	double start = now_ns();
+	for (i = 0; i < n; i++)
+		intq_offer(&q, keys[i], &keys[i]);
+	double offered = now_ns();
+
+	volatile int sink = 0;
+	for (i = 0; i < n; i++)
+		sink += intq_peek_key(&q);
+	double peeked = now_ns();
+
+	int last = -1, sorted = 1;
+	for (i = 0; i < n; i++)
+	{
+		int key = *(int *)intq_poll(&q);
+		if (key < last)
+			sorted = 0;
+		last = key;
+	}
+	double polled = now_ns();
+
+	for (i = 0; i < n; i++)
+		TIME_ONE(&offer_lat, intq_offer(&q, keys[i], &keys[i]));
+	for (i = 0; i < n; i++)
+		TIME_ONE(&peek_lat, sink += intq_peek_key(&q));
+	for (i = 0; i < n; i++)
+		TIME_ONE(&poll_lat, intq_poll(&q));
+
+	intq_destroy(&q);
+	(void)sink;
+
+	report("typed", order, n, "offer", (offered - start) / n, &offer_lat, n, -1);
+	report("typed", order, n, "peek", (peeked - offered) / n, &peek_lat, n, -1);
+	report("typed", order, n, sorted ? "poll" : "poll(BAD)", (polled - peeked) / n, &poll_lat, n, -1);
+}
+
+int main(int argc, char **argv)
+{
+	int default_sizes[] = { 1000, 100000, 1000000 };
+	int list_limit = LIST_LIMIT;
+	int num_sizes, s, i, c;
+	key_order_t order;
+
+	while ((c = getopt(argc, argv, "l:")) != -1)
+	{
+		if (c != 'l')
+		{
+			fprintf(stderr, "Usage: %s [-l list_limit] [size ...]\n", argv[0]);
+			return 1;
+		}
+		list_limit = atoi(optarg);
+	}
+	num_sizes = optind < argc ? argc - optind : 3;
+
+	srand(678);
+
+	printf("%-6s %-8s %8s %-10s %12s %10s %10s %10s %10s\n",
+			"queue", "keys", "size", "op", "ns/op", "p50 ns", "p99 ns", "max ns", "allocs/op");
+
+	for (s = 0; s < num_sizes; s++)
+	{
+		int n = optind < argc ? atoi(argv[optind + s]) : default_sizes[s];
+		if (n <= 0)
+			continue;
+
+		int *keys = malloc(n * sizeof(int));
+
+		for (order = KEYS_RANDOM; order <= KEYS_REVERSE; order++)
+		{
+			for (i = 0; i < n; i++)
+				keys[i] = order == KEYS_RANDOM ? rand() : order == KEYS_SORTED ? i : n - i;
+
+			if (n <= list_limit)
+			{
+				bench("list", PRIQUEUE_LIST, 0, keys, n, order);
+				bench("pool", PRIQUEUE_LIST, 1, keys, n, order);
+			}
+			else
+				printf("%-6s %-8s %8d skipped (quadratic)\n", "list", order_names[order], n);
+			bench("heap", PRIQUEUE_HEAP, 0, keys, n, order);
+			bench_bulk(keys, n, order);
+			bench_specialized(keys, n, order);
+		}
+
+		free(keys);
+	}
+
+	return 0;
+}
@@ -5,6 +5,10 @@
 #include <stdlib.h>
 
 #include "libpriqueue/libpriqueue.h"
+#include "libpriqueue/priqueue_define.h"
+
+#define INT_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+PRIQUEUE_DEFINE(intq, int, INT_CMP)
 
 int compare1(const void * a, const void * b)
 {
@@ -16,12 +20,14 @@ int compare2(const void * a, const void * b)
 	return ( *(int*)b - *(int*)a );
 }
 
-int main()
+void test_backend(const char *name, priqueue_backend_t backend)
 {
 	priqueue_t q, q2;
 
-	priqueue_init(&q, compare1);
-	priqueue_init(&q2, compare2);
+	printf("=== %s backend ===\n", name);
+
+	priqueue_init_backend(&q, compare1, backend);
+	priqueue_init_backend(&q2, compare2, backend);
 
 	/* Pupulate some data... */
 	int *values = malloc(100 * sizeof(int));
@@ -69,6 +75,122 @@ int main()
 	priqueue_destroy(&q);
 
 	free(values);
+}
+
+void test_handles()
+{
+	priqueue_t q;
+	int values[5] = { 50, 40, 30, 20, 10 };
+	priqueue_handle_t handles[5];
+	int i;
+
+	printf("=== heap handles ===\n");
+
+	priqueue_init_backend(&q, compare1, PRIQUEUE_HEAP);
+	for (i = 0; i < 5; i++)
+		handles[i] = priqueue_offer_handle(&q, &values[i]);
+
+	int *removed = priqueue_remove_handle(&q, handles[3]);
+	printf("Removed by handle: %d (expected 20).\n", *removed);
+	printf("Stale handle removes: %s (expected NULL).\n", priqueue_remove_handle(&q, handles[3]) ? "value" : "NULL");
+
+	values[0] = 5;
+	priqueue_update_key(&q, handles[0]);
+	values[4] = 45;
+	priqueue_update_key(&q, handles[4]);
+
+	printf("Elements after re-keying (expected 5 30 40 45): ");
+	while (priqueue_size(&q) > 0)
+		printf("%d ", *((int *)priqueue_poll(&q)));
+	printf("\n");
+
+	priqueue_destroy(&q);
+}
+
+void test_pool()
+{
+	priqueue_t q;
+	int values[100];
+	int i, round;
+
+	printf("=== pooled list ===\n");
+
+	priqueue_init_pool(&q, compare1, PRIQUEUE_LIST, 100);
+	unsigned long allocs = priqueue_alloc_count(&q);
+
+	for (round = 0; round < 10; round++)
+	{
+		for (i = 0; i < 100; i++)
+		{
+			values[i] = (i * 37) % 100;
+			priqueue_offer(&q, &values[i]);
+		}
+		while (priqueue_size(&q) > 0)
+			priqueue_poll(&q);
+	}
+
+	printf("Allocations after warm-up: %lu (expected 0).\n", priqueue_alloc_count(&q) - allocs);
+
+	priqueue_destroy(&q);
+	printf("Unfreed blocks: %lu (expected 0).\n", priqueue_alloc_count(&q) - priqueue_free_count(&q));
+}
+
+void test_batch(const char *name, priqueue_backend_t backend)
+{
+	priqueue_t q;
+	int values[8] = { 40, 10, 30, 20, 10, 25, 5, 50 };
+	void *initial[4] = { &values[0], &values[1], &values[2], &values[3] };
+	void *batch[4] = { &values[6], &values[4], &values[5], &values[7] };
+	int i;
+
+	printf("=== %s batch ===\n", name);
+
+	priqueue_init_from_array(&q, compare1, backend, initial, 4);
+	printf("Total elements: %d (expected 4).\n", priqueue_size(&q));
+
+	priqueue_offer_batch(&q, batch, 4);
+	printf("Elements after batch (expected 5 10 10 20 25 30 40 50): ");
+	for (i = 0; i < priqueue_size(&q); i++)
+		printf("%d ", *((int *)priqueue_at(&q, i)));
+	printf("\n");
+
+	printf("Equal elements keep FIFO order: %s (expected yes).\n",
+			priqueue_at(&q, 1) == &values[1] && priqueue_at(&q, 2) == &values[4] ? "yes" : "no");
+
+	priqueue_destroy(&q);
+}
+
+void test_specialized()
+{
+	intq_t q;
+	int payload[4] = { 0, 1, 2, 3 };
+
+	printf("=== specialized ===\n");
+
+	intq_init(&q);
+	intq_offer(&q, 30, &payload[0]);
+	intq_offer(&q, 10, &payload[1]);
+	intq_offer(&q, 20, &payload[2]);
+	intq_offer(&q, 10, &payload[3]);
+
+	printf("Top key: %d (expected 10).\n", intq_peek_key(&q));
+	printf("Payload order (expected 1 3 2 0): ");
+	while (intq_size(&q) > 0)
+		printf("%d ", *((int *)intq_poll(&q)));
+	printf("\n");
+
+	intq_destroy(&q);
+}
+
+int main()
+{
+	test_backend("list", PRIQUEUE_LIST);
+	test_backend("heap", PRIQUEUE_HEAP);
+	test_handles();
+	test_pool();
+	test_batch("list", PRIQUEUE_LIST);
+	test_batch("heap", PRIQUEUE_HEAP);
+	test_specialized();
 
 	return 0;
 }
@@ -0,0 +1,238 @@
+/** @file replay.c
+ *
+ * Runs a scheduler log (see schedlog.h) through libscheduler again, with
+ * none of the simulator's bookkeeping. Every call is made with the
+ * recorded arguments and its result is checked against the recorded one,
+ * so a log made with one build of the library can be replayed against
+ * another to find the first decision where they differ:
+ *
+ *   ./simulator -q -e -R psjf.log -c 4 -s psjf trace.csv
+ *   ./replay -n 20 psjf.log
+ *
+ * The log is decoded into memory before the clock starts. -n repeats the
+ * replay on a fresh scheduler and reports the fastest run; -l also times
+ * every call on its own and prints p50/p99/max per kind of call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "libscheduler/libscheduler.h"
+#include "libscheduler/schedlog.h"
+#include "libscheduler/histogram.h"
+
+const char *scheme_names[] = { "fcfs", "sjf", "psjf", "pri", "ppri", "rr", "mlfq", "cfs" };
+const char *call_names[] = { "", "new_job", "job_finished", "quantum_expired" };
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-n <repeat>] [-l] <log>\n", program_name);
+	fprintf(stderr, "       ./simulator -q -R run.log -c 2 -s rr2 examples/proc1.csv && %s run.log\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -n  replay this many times and report the fastest (default 1)\n");
+	fprintf(stderr, "  -l  also time each call and print p50/p99/max per kind of call\n");
+}
+
+double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int call(scheduler_t *s, schedlog_event_t *event)
+{
+	switch (event->kind)
+	{
+		case SCHEDLOG_NEW_JOB:
+			return sched_new_job(s, event->job_number, event->time, event->running_time, event->priority);
+		case SCHEDLOG_JOB_FINISHED:
+			return sched_job_finished(s, event->core_id, event->job_number, event->time);
+		default:
+			return sched_quantum_expired(s, event->core_id, event->time);
+	}
+}
+
+scheduler_t *create(schedlog_t *log)
+{
+	scheduler_t *s = scheduler_create(log->cores, log->scheme);
+	if (log->per_core)
+		sched_use_per_core_queues(s);
+	return s;
+}
+
+/*
+ * Replays every event once. Returns the index of the first event whose
+ * result differs from the log and sets *got to that result, or returns -1
+ * if they all match.
+ */
+int replay(scheduler_t *s, schedlog_event_t *events, int num_events, histogram_t *latency, int *got)
+{
+	int i;
+
+	for (i = 0; i < num_events; i++)
+	{
+		int result;
+
+		if (latency != NULL)
+		{
+			double start = now_ns();
+			result = call(s, &events[i]);
+			histogram_record(&latency[events[i].kind], (int)(now_ns() - start));
+		}
+		else
+			result = call(s, &events[i]);
+
+		if (result != events[i].result)
+		{
+			*got = result;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void print_event(schedlog_event_t *event)
+{
+	if (event->kind == SCHEDLOG_NEW_JOB)
+		printf("scheduler_new_job(job %d, time %d, running time %d, priority %d)", event->job_number, event->time,
+				event->running_time, event->priority);
+	else if (event->kind == SCHEDLOG_JOB_FINISHED)
+		printf("scheduler_job_finished(core %d, job %d, time %d)", event->core_id, event->job_number, event->time);
+	else
+		printf("scheduler_quantum_expired(core %d, time %d)", event->core_id, event->time);
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, repeat = 1, latencies = 0;
+
+	while ((c = getopt(argc, argv, "n:l")) != -1)
+	{
+		switch (c)
+		{
+			case 'n':
+				repeat = atoi(optarg);
+				if (repeat <= 0)
+				{
+					fprintf(stderr, "Option -n <repeat> requires a positive number.\n");
+					return 1;
+				}
+				break;
+
+			case 'l':
+				latencies = 1;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	/*
+	 * Decode the whole log first.
+	 */
+	schedlog_t *log = schedlog_open(argv[optind]);
+	if (log == NULL)
+	{
+		fprintf(stderr, "Unable to read a scheduler log from \"%s\".\n", argv[optind]);
+		return 2;
+	}
+
+	int num_events = 0, capacity = 1 << 16, status;
+	long long counts[4] = { 0 };
+	schedlog_event_t *events = malloc(capacity * sizeof(schedlog_event_t));
+
+	while ((status = schedlog_read(log, &events[num_events])) == 1)
+	{
+		counts[events[num_events].kind]++;
+		if (++num_events == capacity)
+		{
+			capacity *= 2;
+			events = realloc(events, capacity * sizeof(schedlog_event_t));
+		}
+	}
+
+	if (status < 0)
+	{
+		fprintf(stderr, "The log is truncated or malformed after %d call(s).\n", num_events);
+		return 2;
+	}
+
+	printf("Replaying %d call(s) (%lld new_job, %lld job_finished, %lld quantum_expired) on %d core(s) using %s%s\n\n",
+			num_events, counts[SCHEDLOG_NEW_JOB], counts[SCHEDLOG_JOB_FINISHED], counts[SCHEDLOG_QUANTUM_EXPIRED],
+			log->cores, scheme_names[log->scheme], log->per_core ? " with per-core queues" : "");
+
+	/*
+	 * Timed runs.
+	 */
+	double best_ns = -1;
+	scheduler_t *s = NULL;
+
+	for (i = 0; i < repeat; i++)
+	{
+		if (s != NULL)
+			scheduler_destroy(s);
+		s = create(log);
+
+		double start = now_ns();
+		int got, diverged = replay(s, events, num_events, NULL, &got);
+		double elapsed = now_ns() - start;
+
+		if (diverged != -1)
+		{
+			printf("Diverged at call %d: ", diverged);
+			print_event(&events[diverged]);
+			printf(" returned %d, the log says %d.\n", got, events[diverged].result);
+			return 3;
+		}
+
+		if (best_ns < 0 || elapsed < best_ns)
+			best_ns = elapsed;
+	}
+
+	printf("All %d result(s) match the log.\n", num_events);
+	printf("Average Waiting Time: %.2f\n", sched_average_waiting_time(s));
+	printf("Average Turnaround Time: %.2f\n", sched_average_turnaround_time(s));
+	printf("Average Response Time: %.2f\n", sched_average_response_time(s));
+	printf("Replay: %.3f ms, %.1f ns per call (fastest of %d)\n", best_ns / 1e6,
+			num_events > 0 ? best_ns / num_events : 0, repeat);
+
+	/*
+	 * Per-call latency, in a separate run so the timing does not slow the
+	 * one above.
+	 */
+	if (latencies)
+	{
+		histogram_t latency[4];
+		int kind, got;
+
+		for (kind = 0; kind < 4; kind++)
+			histogram_init(&latency[kind]);
+
+		scheduler_destroy(s);
+		s = create(log);
+		replay(s, events, num_events, latency, &got);
+
+		for (kind = SCHEDLOG_NEW_JOB; kind <= SCHEDLOG_QUANTUM_EXPIRED; kind++)
+			if (latency[kind].total > 0)
+				printf("%-16s p50/p99/max: %d/%d/%d ns\n", call_names[kind], histogram_percentile(&latency[kind], 50),
+						histogram_percentile(&latency[kind], 99), histogram_percentile(&latency[kind], 100));
+	}
+
+	scheduler_destroy(s);
+	schedlog_close(log);
+	free(events);
+
+	return 0;
+}
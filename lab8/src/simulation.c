@@ -0,0 +1,394 @@
+/** @file simulation.c
+ *
+ * The simulator's main loop, shared by every program that runs a trace
+ * through libscheduler on a simulated clock. Each time unit (or, in
+ * event-driven mode, each stretch up to the next event) handles finished
+ * jobs first, then quantum expiry, then arrivals, and then runs the cores.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "simulation.h"
+#include "tracefile.h"
+
+/**
+  Parses a scheme name as given to -s: fcfs, sjf, psjf, pri, ppri, rr#,
+  mlfq# or cfs#, in any case.
+
+  @return 1 on success, 0 if the name is unknown, -1 if the scheme needs a
+  positive quantum and has none; *scheme is set unless the name is unknown
+ */
+int sim_parse_scheme(const char *text, scheme_t *scheme, int *quantum)
+{
+	*quantum = 0;
+
+	if (strcasecmp(text, "FCFS") == 0) { *scheme = FCFS; }
+	else if (strcasecmp(text, "SJF") == 0) { *scheme = SJF; }
+	else if (strcasecmp(text, "PSJF") == 0) { *scheme = PSJF; }
+	else if (strcasecmp(text, "PRI") == 0) { *scheme = PRI; }
+	else if (strcasecmp(text, "PPRI") == 0) { *scheme = PPRI; }
+	else if (strncasecmp(text, "RR", 2) == 0) { *scheme = RR; *quantum = atoi(text + 2); }
+	else if (strncasecmp(text, "MLFQ", 4) == 0) { *scheme = MLFQ; *quantum = atoi(text + 4); }
+	else if (strncasecmp(text, "CFS", 3) == 0) { *scheme = CFS; *quantum = atoi(text + 3); }
+	else
+		return 0;
+
+	return !scheduler_uses_quantum(*scheme) || *quantum > 0 ? 1 : -1;
+}
+
+/**
+  Orders jobs by arrival time, then by job id.
+ */
+int sim_compare_arrival(const void *a, const void *b)
+{
+	const sim_job_t *job_a = (const sim_job_t *)a;
+	const sim_job_t *job_b = (const sim_job_t *)b;
+
+	if (job_a->arrival_time != job_b->arrival_time)
+		return job_a->arrival_time < job_b->arrival_time ? -1 : 1;
+	return job_a->job_id - job_b->job_id;
+}
+
+/**
+  Reads a trace (see tracefile.h) and sorts its jobs by arrival. Job ids
+  are the order of the jobs in the file.
+
+  @return 1 on success, 0 if the file could not be read
+ */
+int sim_trace_load(sim_trace_t *trace, const char *file_name)
+{
+	int num_records, i;
+	trace_record_t *records = trace_load(file_name, &num_records);
+	if (records == NULL)
+		return 0;
+
+	sim_job_t *jobs = malloc((num_records > 0 ? num_records : 1) * sizeof(sim_job_t));
+	for (i = 0; i < num_records; i++)
+	{
+		jobs[i].job_id = i;
+		jobs[i].arrival_time = records[i].arrival_time;
+		jobs[i].run_time = records[i].run_time;
+		jobs[i].priority = records[i].priority;
+		jobs[i].core_id = -1;
+		jobs[i].arrived = 0;
+		jobs[i].finished = 0;
+		jobs[i].total_run_time = records[i].run_time;
+		jobs[i].first_run_time = -1;
+	}
+	free(records);
+
+	qsort(jobs, num_records, sizeof(sim_job_t), sim_compare_arrival);
+
+	trace->jobs = jobs;
+	trace->num_jobs = num_records;
+	trace->slot_of = malloc((num_records > 0 ? num_records : 1) * sizeof(int));
+	for (i = 0; i < num_records; i++)
+		trace->slot_of[jobs[i].job_id] = i;
+
+	return 1;
+}
+
+void sim_trace_free(sim_trace_t *trace)
+{
+	free(trace->jobs);
+	free(trace->slot_of);
+}
+
+/**
+  Prepares a run of trace through s, which must be a fresh scheduler for
+  the same scheme and number of cores. The trace must outlive the run.
+ */
+void sim_init(sim_t *sim, scheduler_t *s, scheme_t scheme, int quantum, int cores, const sim_trace_t *trace, int event_driven)
+{
+	int n = trace->num_jobs > 0 ? trace->num_jobs : 1;
+	int i;
+
+	sim->s = s;
+	sim->scheme = scheme;
+	sim->cores = cores;
+	sim->quantum = quantum;
+	sim->event_driven = event_driven;
+
+	sim->jobs = malloc(n * sizeof(sim_job_t));
+	memcpy(sim->jobs, trace->jobs, trace->num_jobs * sizeof(sim_job_t));
+	sim->slot_of = trace->slot_of;
+	sim->num_jobs = trace->num_jobs;
+
+	// active[] starts out in load order
+	sim->active = malloc(n * sizeof(int));
+	sim->active_pos = malloc(n * sizeof(int));
+	for (i = 0; i < trace->num_jobs; i++)
+	{
+		sim->active[i] = trace->slot_of[i];
+		sim->active_pos[trace->slot_of[i]] = i;
+	}
+
+	sim->core_job = malloc(cores * sizeof(int));
+	sim->quantum_clock = malloc(cores * sizeof(int));
+	for (i = 0; i < cores; i++)
+	{
+		sim->core_job[i] = -1;
+		sim->quantum_clock[i] = -1;
+	}
+
+	sim->next_arrival = 0;
+	sim->active_jobs = trace->num_jobs;
+	sim->jobs_alive = 0;
+	sim->time = 0;
+	sim->error = SIM_OK;
+	sim->error_value = 0;
+	sim->hooks = NULL;
+}
+
+void sim_free(sim_t *sim)
+{
+	free(sim->jobs);
+	free(sim->active);
+	free(sim->active_pos);
+	free(sim->core_job);
+	free(sim->quantum_clock);
+}
+
+static void active_remove(sim_t *sim, int slot)
+{
+	int pos = sim->active_pos[slot];
+	int last = sim->active[sim->active_jobs - 1];
+
+	sim->active[pos] = last;
+	sim->active_pos[last] = pos;
+	sim->active_jobs--;
+}
+
+/*
+ * Returns the running job that has finished (run_time == 0) and sits
+ * earliest in active[], or -1. Only running jobs can reach zero, so this
+ * looks at one job per core instead of every job.
+ */
+static int next_finished_job(sim_t *sim)
+{
+	int i, found = -1;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		int slot = sim->core_job[i];
+		if (slot != -1 && sim->jobs[slot].run_time == 0 &&
+				(found == -1 || sim->active_pos[slot] < sim->active_pos[found]))
+			found = slot;
+	}
+
+	return found;
+}
+
+static void assign_core(sim_t *sim, int slot, int core_id)
+{
+	sim_job_t *jobs = sim->jobs;
+
+	// Whoever held the core loses it
+	if (sim->core_job[core_id] != -1)
+		jobs[sim->core_job[core_id]].core_id = -1;
+
+	// A job only ever runs on one core
+	if (jobs[slot].core_id != -1 && sim->core_job[jobs[slot].core_id] == slot)
+		sim->core_job[jobs[slot].core_id] = -1;
+
+	jobs[slot].core_id = core_id;
+	sim->core_job[core_id] = slot;
+}
+
+static void release_core(sim_t *sim, int slot)
+{
+	sim_job_t *jobs = sim->jobs;
+
+	if (jobs[slot].core_id != -1 && sim->core_job[jobs[slot].core_id] == slot)
+		sim->core_job[jobs[slot].core_id] = -1;
+	jobs[slot].core_id = -1;
+}
+
+static int set_active_job(sim_t *sim, int job_id, int core_id)
+{
+	if (job_id < 0 || job_id >= sim->num_jobs)
+		return 0;
+
+	int slot = sim->slot_of[job_id];
+	if (!sim->jobs[slot].arrived || sim->jobs[slot].finished)
+		return 0;
+
+	assign_core(sim, slot, core_id);
+	return 1;
+}
+
+static int fail(sim_t *sim, sim_error_t error, int value)
+{
+	sim->error = error;
+	sim->error_value = value;
+	return 0;
+}
+
+/*
+ * In event-driven mode, returns how many time units can be run before the
+ * next arrival, completion or quantum expiry. Nothing observable changes
+ * in between, so the whole span can be simulated at once.
+ */
+static int time_until_next_event(sim_t *sim)
+{
+	int i, span = -1;
+
+	if (sim->next_arrival < sim->num_jobs)
+		span = sim->jobs[sim->next_arrival].arrival_time - sim->time;
+
+	for (i = 0; i < sim->cores; i++)
+	{
+		int slot = sim->core_job[i];
+		if (slot == -1)
+			continue;
+
+		int until = sim->jobs[slot].run_time;
+		if (scheduler_uses_quantum(sim->scheme) && sim->quantum_clock[i] < until)
+			until = sim->quantum_clock[i];
+
+		if (span == -1 || until < span)
+			span = until;
+	}
+
+	return span < 1 ? 1 : span;
+}
+
+/**
+  Runs the simulation until every job has finished or the scheduler makes
+  an invalid decision. sim->time is then the makespan, or the time of the
+  invalid decision.
+
+  @param sim a simulation set up by sim_init()
+  @param hooks callbacks to report progress to, or NULL
+  @return 1 if every job finished, 0 if sim->error says what went wrong
+ */
+int sim_run(sim_t *sim, const sim_hooks_t *hooks)
+{
+	static const sim_hooks_t no_hooks;
+	sim_job_t *jobs = sim->jobs;
+	int uses_quantum = scheduler_uses_quantum(sim->scheme);
+	int i, slot;
+
+	sim->hooks = hooks != NULL ? hooks : &no_hooks;
+	hooks = sim->hooks;
+
+	while (sim->active_jobs > 0)
+	{
+		if (hooks->time_started != NULL)
+			hooks->time_started(sim);
+
+		/*
+		 * 1. Check if any jobs finished in the last time unit.
+		 */
+		while ((slot = next_finished_job(sim)) != -1)
+		{
+			int core_id = jobs[slot].core_id;
+			int new_job_id = sched_job_finished(sim->s, core_id, jobs[slot].job_id, sim->time);
+
+			if (uses_quantum && core_id != -1)
+				sim->quantum_clock[core_id] = sim->quantum;
+
+			// Retire the finished job
+			release_core(sim, slot);
+			active_remove(sim, slot);
+			jobs[slot].finished = 1;
+			sim->jobs_alive--;
+
+			if (new_job_id != -1 && !set_active_job(sim, new_job_id, core_id))
+				return fail(sim, SIM_BAD_FINISHED_JOB, new_job_id);
+			if (hooks->job_finished != NULL)
+				hooks->job_finished(sim, slot, core_id, new_job_id);
+		}
+
+		// Stop before running a last, totally idle time unit
+		if (sim->active_jobs == 0)
+			break;
+
+		/*
+		 * 2. Check if any quantums expired in the last time unit.
+		 */
+		if (uses_quantum)
+		{
+			for (i = 0; i < sim->cores; i++)
+			{
+				if (sim->quantum_clock[i] == 0 && sim->core_job[i] != -1)
+				{
+					slot = sim->core_job[i];
+					int new_job_id = sched_quantum_expired(sim->s, i, sim->time);
+
+					release_core(sim, slot);
+					sim->quantum_clock[i] = sim->quantum;
+
+					if (new_job_id != -1 && !set_active_job(sim, new_job_id, i))
+						return fail(sim, SIM_BAD_EXPIRED_JOB, new_job_id);
+					if (hooks->quantum_expired != NULL)
+						hooks->quantum_expired(sim, slot, i, new_job_id);
+				}
+			}
+		}
+
+		/*
+		 * 3. Check for any new jobs that arrive in this time unit.
+		 */
+		while (sim->next_arrival < sim->num_jobs && jobs[sim->next_arrival].arrival_time <= sim->time)
+		{
+			slot = sim->next_arrival++;
+
+			int core_id = sched_new_job(sim->s, jobs[slot].job_id, sim->time, jobs[slot].run_time, jobs[slot].priority);
+			jobs[slot].arrived = 1;
+			sim->jobs_alive++;
+
+			if (core_id < -1 || core_id >= sim->cores)
+				return fail(sim, SIM_BAD_CORE, core_id);
+			if (hooks->job_arrived != NULL)
+				hooks->job_arrived(sim, slot, core_id);
+
+			// Assign the core to the new job, taking it from anyone using it
+			if (core_id != -1)
+			{
+				assign_core(sim, slot, core_id);
+				if (uses_quantum)
+					sim->quantum_clock[core_id] = sim->quantum;
+			}
+		}
+
+		/*
+		 * 4. Run the time unit. In event-driven mode, run every unit up to
+		 *    the next event at once.
+		 */
+		int cores_working = 0;
+		int span = sim->event_driven ? time_until_next_event(sim) : 1;
+
+		for (i = 0; i < sim->cores; i++)
+		{
+			slot = sim->core_job[i];
+			if (slot != -1)
+			{
+				cores_working++;
+				if (jobs[slot].first_run_time == -1)
+					jobs[slot].first_run_time = sim->time;
+				jobs[slot].run_time -= span;
+				sim->quantum_clock[i] -= span;
+
+				assert(jobs[slot].core_id == i);
+			}
+		}
+
+		if (hooks->time_ran != NULL)
+			hooks->time_ran(sim, span);
+
+		/*
+		 * 5. If there's a job alive (needing to be ran) and all cores are
+		 *    idle, the scheduler failed to schedule properly.
+		 */
+		if (sim->jobs_alive > 0 && cores_working == 0)
+			return fail(sim, SIM_ALL_IDLE, 0);
+
+		sim->time += span;
+	}
+
+	return 1;
+}
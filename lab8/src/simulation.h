@@ -0,0 +1,100 @@
+/** @file simulation.h
+ */
+
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include "libscheduler/libscheduler.h"
+
+/**
+  A job of a trace and its progress through one simulation.
+*/
+typedef struct _sim_job_t
+{
+	int job_id, arrival_time, run_time, priority;
+	int core_id, arrived, finished;
+	int total_run_time, first_run_time;
+} sim_job_t;
+
+/**
+  A loaded trace. Jobs are sorted by arrival time, so positions in jobs[]
+  ("slots") are the order in which jobs arrive. A trace is never modified
+  by a simulation and can be shared by any number of them.
+*/
+typedef struct _sim_trace_t
+{
+	sim_job_t *jobs;
+	int *slot_of; /* job_id -> slot */
+	int num_jobs;
+} sim_trace_t;
+
+typedef enum
+{
+	SIM_OK = 0,
+	SIM_BAD_FINISHED_JOB, /* sched_job_finished() picked an invalid job */
+	SIM_BAD_EXPIRED_JOB,  /* sched_quantum_expired() picked an invalid job */
+	SIM_BAD_CORE,         /* sched_new_job() picked an invalid core */
+	SIM_ALL_IDLE          /* every core idle while a job was waiting */
+} sim_error_t;
+
+struct _sim_t;
+
+/**
+  Called as the simulation advances; any of them may be NULL. New job ids
+  and core ids are -1 when the core stays idle or the job is queued. A
+  decision is only reported once it has been checked.
+*/
+typedef struct _sim_hooks_t
+{
+	void (*time_started)(struct _sim_t *sim);
+	void (*job_finished)(struct _sim_t *sim, int slot, int core_id, int new_job_id);
+	void (*quantum_expired)(struct _sim_t *sim, int slot, int core_id, int new_job_id);
+	void (*job_arrived)(struct _sim_t *sim, int slot, int core_id);
+	void (*time_ran)(struct _sim_t *sim, int span);
+	void *data;
+} sim_hooks_t;
+
+/**
+  The simulator's clock and bookkeeping for one run of a trace through a
+  scheduler.
+
+  Unfinished jobs are listed in active[], which is compacted by moving the
+  last entry into the hole. Only active[] is reordered, never jobs[], and
+  its order decides which of several jobs finishing in the same time unit
+  is reported first.
+*/
+typedef struct _sim_t
+{
+	scheduler_t *s;
+	scheme_t scheme;
+	int cores, quantum, event_driven;
+
+	sim_job_t *jobs; /* a copy of the trace's jobs */
+	const int *slot_of;
+	int num_jobs;
+
+	int next_arrival; /* first slot that has not arrived yet */
+	int *active;      /* unfinished slots */
+	int *active_pos;  /* slot -> position in active[] */
+	int active_jobs;  /* length of active[] */
+	int jobs_alive;   /* arrived and unfinished */
+	int *core_job;    /* core_id -> slot of the job it runs, or -1 */
+	int *quantum_clock;
+	int time;
+
+	sim_error_t error;
+	int error_value; /* the invalid job or core id */
+	const sim_hooks_t *hooks;
+} sim_t;
+
+int  sim_parse_scheme  (const char *text, scheme_t *scheme, int *quantum);
+int  sim_compare_arrival(const void *a, const void *b);
+
+int  sim_trace_load    (sim_trace_t *trace, const char *file_name);
+void sim_trace_free    (sim_trace_t *trace);
+
+void sim_init          (sim_t *sim, scheduler_t *s, scheme_t scheme, int quantum, int cores, const sim_trace_t *trace, int event_driven);
+int  sim_run           (sim_t *sim, const sim_hooks_t *hooks);
+void sim_free          (sim_t *sim);
+
+#endif /* SIMULATION_H_ */
@@ -7,56 +7,50 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <assert.h>
 
 #include "libscheduler/libscheduler.h"
+#include "simulation.h"
 
 
-typedef struct _simulator_job_list_t
-{
-	int job_id, arrival_time, run_time, priority;
-	int core_id, arrived;
-} simulator_job_list_t;
-
 void print_usage(char *program_name)
 {
-	fprintf(stderr, "Usage: %s -c <cores> -s <scheme> <input file>\n", program_name);
+	fprintf(stderr, "Usage: %s [-e] [-r] [-q] [-p] [-l] [-j <file>] [-t <file>] [-R <file>] -c <cores> -s <scheme> <input file>\n", program_name);
 	fprintf(stderr, "       %s -c 2 -s fcfs examples/proc1.csv\n", program_name);
 	fprintf(stderr, "\n");
-	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#\n");
-}
-
-int set_active_job(int job_id, int core_id, simulator_job_list_t *jobs, int active_jobs)
-{
-	int i;
-	for (i = 0; i < active_jobs; i++)
-	{
-		if (jobs[i].job_id == job_id && jobs[i].arrived)
-		{
-			jobs[i].core_id = core_id;
-			return 1;
-		}
-	}
-
-	return 0;
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq#, cfs#\n");
+	fprintf(stderr, "An input file of \"-\" reads the trace from stdin (e.g. from ./tracegen).\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -e  event-driven mode: skip ahead to the next arrival, completion or\n");
+	fprintf(stderr, "      quantum expiry instead of simulating every time unit\n");
+	fprintf(stderr, "  -r  print timing diagrams run-length encoded (e.g. 3x12,-x4)\n");
+	fprintf(stderr, "  -q  quiet/batch mode: print only the final averages\n");
+	fprintf(stderr, "  -p  give every core its own run queue, with work stealing, and report\n");
+	fprintf(stderr, "      how often jobs migrated between cores\n");
+	fprintf(stderr, "  -l  also print p50/p90/p99/p99.9/max of waiting, turnaround and\n");
+	fprintf(stderr, "      response time\n");
+	fprintf(stderr, "  -j  write per-job statistics to <file> as CSV\n");
+	fprintf(stderr, "  -t  stream the timing diagram to <file> as \"core,run\" lines while it\n");
+	fprintf(stderr, "      is produced, keeping only the current run of each core in memory\n");
+	fprintf(stderr, "  -R  record every scheduler call and its result to <file> for ./replay\n");
 }
 
-void print_available_jobs(simulator_job_list_t *jobs, int active_jobs)
+void print_available_jobs(sim_t *sim)
 {
 	printf("Active jobs are: ");
 
 	int i, first = 1;
-	for (i = 0; i < active_jobs; i++)
+	for (i = 0; i < sim->active_jobs; i++)
 	{
-		if (jobs[i].arrived)
+		int slot = sim->active[i];
+		if (sim->jobs[slot].arrived)
 		{
 			if (first)
 			{
-				printf("%d", jobs[i].job_id);
+				printf("%d", sim->jobs[slot].job_id);
 				first = 0;
 			}
 			else
-				printf(", %d", jobs[i].job_id);
+				printf(", %d", sim->jobs[slot].job_id);
 		}
 	}
 
@@ -79,19 +73,351 @@ void print_available_cores(int cores)
 }
 
 
+/*
+ * Timing diagrams are stored run-length encoded: one (job, length) pair per
+ * stretch of time a core spends on the same job (job -1 is idle). Appending
+ * is O(1) however long the simulation runs.
+ *
+ * When a stream is attached, each run is written out as soon as it closes
+ * and only the open run is kept, so memory stays bounded.
+ *
+ * The expanded one-character-per-unit form is only materialized when it is
+ * printed, and only the part added since the last print is rendered.
+ */
+typedef struct _timeline_run_t
+{
+	int job_id, length;
+} timeline_run_t;
+
+typedef struct _timeline_t
+{
+	timeline_run_t *runs;
+	int num_runs, capacity;
+	int core_id, streamed;
+	FILE *stream;
+
+	char *rendered;
+	int rendered_length, rendered_capacity;
+	int rendered_runs, rendered_units; /* how much of runs[] is in rendered */
+} timeline_t;
+
+void job_label(int job_id, char *label)
+{
+	if (job_id < 0)
+		strcpy(label, "-");
+	else if (job_id < 10)
+		sprintf(label, "%d", job_id);
+	else if (job_id < 10 + 26)
+		sprintf(label, "%c", job_id - 10 + 'a');
+	else if (job_id < 10 + 26 + 26)
+		sprintf(label, "%c", job_id - 10 - 26 + 'A');
+	else
+		snprintf(label, 16, "(%d)", job_id);
+}
+
+void timeline_init(timeline_t *timeline, int core_id, FILE *stream)
+{
+	timeline->capacity = 16;
+	timeline->runs = malloc(timeline->capacity * sizeof(timeline_run_t));
+	timeline->num_runs = 0;
+	timeline->core_id = core_id;
+	timeline->streamed = 0;
+	timeline->stream = stream;
+
+	timeline->rendered = NULL;
+	timeline->rendered_length = timeline->rendered_capacity = 0;
+	timeline->rendered_runs = timeline->rendered_units = 0;
+}
+
+void timeline_flush(timeline_t *timeline)
+{
+	char label[16];
+	int i;
+
+	if (timeline->stream == NULL)
+		return;
+
+	for (i = 0; i < timeline->num_runs; i++)
+	{
+		job_label(timeline->runs[i].job_id, label);
+		fprintf(timeline->stream, "%d,%sx%d\n", timeline->core_id, label, timeline->runs[i].length);
+	}
+	timeline->streamed += timeline->num_runs;
+	timeline->num_runs = 0;
+}
+
+void timeline_append(timeline_t *timeline, int job_id, int length)
+{
+	if (timeline->num_runs > 0 && timeline->runs[timeline->num_runs - 1].job_id == job_id)
+	{
+		timeline->runs[timeline->num_runs - 1].length += length;
+		return;
+	}
+
+	// The last run just closed; a streaming timeline only keeps the open one
+	if (timeline->stream != NULL)
+		timeline_flush(timeline);
+
+	if (timeline->num_runs == timeline->capacity)
+	{
+		timeline->capacity *= 2;
+		timeline->runs = realloc(timeline->runs, timeline->capacity * sizeof(timeline_run_t));
+	}
+
+	timeline->runs[timeline->num_runs].job_id = job_id;
+	timeline->runs[timeline->num_runs].length = length;
+	timeline->num_runs++;
+}
+
+/*
+ * Brings the expanded rendering up to date with runs[]. Runs that were fully
+ * rendered before are not touched again.
+ */
+void timeline_render(timeline_t *timeline)
+{
+	char label[16];
+
+	while (timeline->rendered_runs < timeline->num_runs)
+	{
+		timeline_run_t *run = &timeline->runs[timeline->rendered_runs];
+		int units = run->length - timeline->rendered_units;
+
+		job_label(run->job_id, label);
+		int label_length = strlen(label);
+
+		if (timeline->rendered_length + units * label_length + 1 > timeline->rendered_capacity)
+		{
+			timeline->rendered_capacity = 2 * (timeline->rendered_length + units * label_length + 1);
+			timeline->rendered = realloc(timeline->rendered, timeline->rendered_capacity);
+		}
+
+		for (; units > 0; units--)
+		{
+			memcpy(timeline->rendered + timeline->rendered_length, label, label_length);
+			timeline->rendered_length += label_length;
+		}
+
+		// The last run may still grow, so remember how much of it is done
+		if (timeline->rendered_runs == timeline->num_runs - 1)
+		{
+			timeline->rendered_units = run->length;
+			break;
+		}
+		timeline->rendered_runs++;
+		timeline->rendered_units = 0;
+	}
+}
+
+/*
+ * Prints the diagram either expanded, one character per time unit as the
+ * original simulator did ("333333333333----"), or run-length encoded
+ * ("3x12,-x4").
+ */
+void timeline_print(timeline_t *timeline, int rle)
+{
+	char label[16];
+	int i, j;
+
+	// Runs that were already streamed out are elided
+	if (timeline->streamed > 0)
+		fputs("...", stdout);
+
+	if (rle)
+	{
+		for (i = 0; i < timeline->num_runs; i++)
+		{
+			job_label(timeline->runs[i].job_id, label);
+			printf("%s%sx%d", i ? "," : "", label, timeline->runs[i].length);
+		}
+		return;
+	}
+
+	if (timeline->stream != NULL)
+	{
+		// Only the open run is left in memory; draw it without caching
+		for (i = 0; i < timeline->num_runs; i++)
+		{
+			job_label(timeline->runs[i].job_id, label);
+			for (j = 0; j < timeline->runs[i].length; j++)
+				fputs(label, stdout);
+		}
+		return;
+	}
+
+	timeline_render(timeline);
+	fwrite(timeline->rendered, 1, timeline->rendered_length, stdout);
+}
+
+void print_timing_diagram(timeline_t *timelines, int cores, int rle)
+{
+	int i;
+
+	for (i = 0; i < cores; i++)
+	{
+		printf("  Core %2d: ", i);
+		timeline_print(&timelines[i], rle);
+		printf("\n");
+	}
+}
+
+void timeline_free(timeline_t *timeline)
+{
+	timeline_flush(timeline);
+	free(timeline->runs);
+	free(timeline->rendered);
+}
+
+/*
+ * What the simulator prints as the simulation advances (see sim_hooks_t).
+ */
+typedef struct _simulator_output_t
+{
+	int quiet, rle_diagram, keep_timeline;
+	timeline_t *timelines;
+	FILE *job_stats;
+} simulator_output_t;
+
+void on_time_started(sim_t *sim)
+{
+	simulator_output_t *out = (simulator_output_t *)sim->hooks->data;
+
+	if (!out->quiet)
+		printf("=== [TIME %d] ===\n", sim->time);
+}
+
+void on_job_finished(sim_t *sim, int slot, int core_id, int new_job_id)
+{
+	simulator_output_t *out = (simulator_output_t *)sim->hooks->data;
+	sim_job_t *job = &sim->jobs[slot];
+
+	if (out->job_stats != NULL)
+	{
+		int turnaround = sim->time - job->arrival_time;
+		fprintf(out->job_stats, "%d,%d,%d,%d,%d,%d,%d,%d,%d\n", job->job_id, job->arrival_time,
+				job->total_run_time, job->priority, job->first_run_time, sim->time,
+				turnaround - job->total_run_time, turnaround, job->first_run_time - job->arrival_time);
+	}
+
+	if (!out->quiet)
+	{
+		printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job->job_id, core_id, core_id, new_job_id);
+		printf("  Queue: "); sched_show_queue(sim->s); printf("\n\n");
+	}
+}
+
+void on_quantum_expired(sim_t *sim, int slot, int core_id, int new_job_id)
+{
+	simulator_output_t *out = (simulator_output_t *)sim->hooks->data;
+
+	if (!out->quiet)
+	{
+		printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", sim->jobs[slot].job_id, core_id, core_id, new_job_id);
+		printf("  Queue: "); sched_show_queue(sim->s); printf("\n\n");
+	}
+}
+
+void on_job_arrived(sim_t *sim, int slot, int core_id)
+{
+	simulator_output_t *out = (simulator_output_t *)sim->hooks->data;
+	sim_job_t *job = &sim->jobs[slot];
+
+	if (out->quiet)
+		return;
+
+	if (core_id != -1)
+		printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
+				job->job_id, job->run_time, job->priority, job->job_id, core_id);
+	else
+		printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
+				job->job_id, job->run_time, job->priority, job->job_id);
+	printf("  Queue: "); sched_show_queue(sim->s); printf("\n\n");
+}
+
+void on_time_ran(sim_t *sim, int span)
+{
+	simulator_output_t *out = (simulator_output_t *)sim->hooks->data;
+	int i;
+
+	// An idle core is drawn as '-'
+	if (out->keep_timeline)
+		for (i = 0; i < sim->cores; i++)
+			timeline_append(&out->timelines[i], sim->core_job[i] != -1 ? sim->jobs[sim->core_job[i]].job_id : -1, span);
+
+	if (!out->quiet)
+	{
+		printf("At the end of time unit %d...\n", sim->time + span - 1);
+
+		print_timing_diagram(out->timelines, sim->cores, out->rle_diagram);
+
+		printf("\n");
+
+		printf("  Queue: ");
+		sched_show_queue(sim->s);
+		printf("\n");
+		printf("\n");
+	}
+}
+
+
 int main(int argc, char **argv)
 {
 	int c;
 	int cores = 0, scheme = -1, quantum = 0;
-	char *file_name;
+	int event_driven = 0, rle_diagram = 0, quiet = 0, per_core = 0, percentiles = 0;
+	FILE *timing_stream = NULL, *job_stats = NULL;
+	char *file_name, *record_file = NULL;
+	scheme_t parsed;
 
 	/*
 	 * Parse command line options.
 	 */
-	while ((c = getopt(argc, argv, "c:s:")) != -1)
+	while ((c = getopt(argc, argv, "c:s:ert:qplj:R:")) != -1)
 	{
 		switch (c)
 		{
+			case 'e':
+				event_driven = 1;
+				break;
+
+			case 'r':
+				rle_diagram = 1;
+				break;
+
+			case 'q':
+				quiet = 1;
+				break;
+
+			case 'p':
+				per_core = 1;
+				break;
+
+			case 'l':
+				percentiles = 1;
+				break;
+
+			case 'j':
+				job_stats = fopen(optarg, "w");
+				if (job_stats == NULL)
+				{
+					fprintf(stderr, "Unable to open file \"%s\".\n", optarg);
+					return 2;
+				}
+				fprintf(job_stats, "job_id,arrival_time,run_time,priority,first_run_time,finish_time,waiting_time,turnaround_time,response_time\n");
+				break;
+
+			case 'R':
+				record_file = optarg;
+				break;
+
+			case 't':
+				timing_stream = fopen(optarg, "w");
+				if (timing_stream == NULL)
+				{
+					fprintf(stderr, "Unable to open file \"%s\".\n", optarg);
+					return 2;
+				}
+				break;
+
 			case 'c':
 				cores = atoi(optarg);
 
@@ -104,22 +430,16 @@ int main(int argc, char **argv)
 				break;
 
 			case 's':
-				if (strcasecmp(optarg, "FCFS") == 0) { scheme = FCFS; }
-				else if (strcasecmp(optarg, "SJF") == 0) { scheme = SJF; }
-				else if (strcasecmp(optarg, "PSJF") == 0) { scheme = PSJF; }
-				else if (strcasecmp(optarg, "PRI") == 0) { scheme = PRI; }
-				else if (strcasecmp(optarg, "PPRI") == 0) { scheme = PPRI; }
-				else if (strncasecmp(optarg, "RR", 2) == 0)
+				switch (sim_parse_scheme(optarg, &parsed, &quantum))
 				{
-					scheme = RR;
-					quantum = atoi(optarg + 2);
+					case 1:
+						scheme = parsed;
+						break;
 
-					if (quantum <= 0)
-					{
-						fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR. (Eg: -s RR2)\n");
+					case -1:
+						fprintf(stderr, "Option -s <scheme> requires a positive number for the quantum of RR, MLFQ and CFS. (Eg: -s RR2)\n");
 						print_usage(argv[0]);
 						return 1;
-					}
 				}
 				break;
 
@@ -158,335 +478,123 @@ int main(int argc, char **argv)
 
 
 	/*
-	 * Open the file, read the file, and populate the jobs data structure.
+	 * Read the file and populate the jobs data structure.
 	 */
-	FILE *file = fopen(file_name, "r");
-	if (file == NULL)
-	{
-		fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+	sim_trace_t trace;
+	if (!sim_trace_load(&trace, file_name))
 		return 2;
-	}
-
-
-	int job_id = 0;
-	int jobs_ct = 10;
-	simulator_job_list_t* jobs = malloc(jobs_ct * sizeof(simulator_job_list_t));
-
-	char line[1024 + 1];
-	fgets(line, 1024, file);  // Ignore the first (header) line
-	while (fgets(line, 1024, file) != NULL)
-	{
-		char *arrival_time = strtok(line, ",");
-		char *run_time = strtok(NULL, ",");
-		char *priority = strtok(NULL, ",");
-
-		if (arrival_time != NULL && run_time != NULL && priority != NULL)
-		{
-			if (job_id == jobs_ct)
-			{
-				jobs_ct *= 2;
-				jobs = realloc(jobs, jobs_ct * sizeof(simulator_job_list_t));
-
-				if (!jobs)
-				{
-					fprintf(stderr, "Out of memory.\n");
-					return 2;
-				}
-			}
-
-			jobs[job_id].job_id = job_id;
-			jobs[job_id].arrival_time = atoi(arrival_time);
-			jobs[job_id].run_time = atoi(run_time);
-			jobs[job_id].priority = atoi(priority);
-			jobs[job_id].core_id = -1;
-			jobs[job_id].arrived = 0;
-
-			job_id++;
-		}
-		else
-		{
-			fprintf(stderr, "Illegal file format.\n");
-			return 2;
-		}
-	}
-
-	fclose(file);
 
 
 	/*
 	 * Run the simulation.
 	 */
 
-	printf("Loaded %d core(s) and %d job(s) using ", cores, job_id);
-	if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
-	else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
-	else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
-	else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
-	else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
-	else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
-	printf(" scheduling...\n\n");
-
-	scheduler_start_up(cores, scheme);
-
-
-	int time = 0, i, j;
-	int active_jobs = job_id, jobs_alive = 0;
-
-	int *quantum_clock = malloc(cores * sizeof(int));
-	char **core_timing_diagram = malloc(cores * sizeof(char *));
-	int core_timing_diagram_size = 1024;
-
-	for (i = 0; i < cores; i++)
+	if (!quiet)
 	{
-		quantum_clock[i] = -1;
-		core_timing_diagram[i] = malloc(core_timing_diagram_size + 1);
-		core_timing_diagram[i][0] = '\0';
+		printf("Loaded %d core(s) and %d job(s) using ", cores, trace.num_jobs);
+		if (scheme == FCFS) { printf("First Come First Served (FCFS)"); }
+		else if (scheme == SJF) { printf("Non-preemptive Shortest Job First (SJF)"); }
+		else if (scheme == PSJF) { printf("Preemptive Shortest Job First (PSJF)"); }
+		else if (scheme == PRI) { printf("Non-preemptive Priority (PRI)"); }
+		else if (scheme == PPRI) { printf("Preemptive Priority (PPRI)"); }
+		else if (scheme == RR) { printf("Round Robin (RR) with a quantum of %d", quantum); }
+		else if (scheme == MLFQ) { printf("Multi-Level Feedback Queue (MLFQ) with a base quantum of %d", quantum); }
+		else if (scheme == CFS) { printf("Completely Fair Scheduler (CFS) with a tick of %d", quantum); }
+		printf(" scheduling...\n\n");
 	}
 
-	while (active_jobs > 0)
+	scheduler_t *s = scheduler_create(cores, scheme);
+	if (per_core)
+		sched_use_per_core_queues(s);
+	if (record_file != NULL && sched_record(s, record_file) != 0)
 	{
-		printf("=== [TIME %d] ===\n", time);
-
-		/*
-		 * 1. Check if any jobs finished in the last time unit.
-		 */
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].run_time == 0)
-			{
-				// Notify the scheduler has finished
-				int job_id = jobs[i].job_id;
-				int core_id = jobs[i].core_id;
-				int new_job_id = scheduler_job_finished(jobs[i].core_id, jobs[i].job_id, time);
-
-				if (scheme == RR)
-					quantum_clock[jobs[i].core_id] = quantum;
-
-				// Delete the finished jobs, decrease the number of active jobs
-				if (i != active_jobs - 1)
-					memcpy(&jobs[i], &jobs[active_jobs - 1], sizeof(simulator_job_list_t));
-				active_jobs--;
-				jobs_alive--;
-				i--;
-
-				// Set the new job
-				if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-				{
-					printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", new_job_id);
-					print_available_jobs(jobs, active_jobs);
-					return 3;
-				}
-				else
-				{
-					printf("Job %d, running on core %d, finished. Core %d is now running job %d.\n", job_id, core_id, core_id, new_job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-			}
-		}
-
-		/*
-		 * Check to see if we finished our last job.  (If we don't check here, we would run an extra time unit that will be totally idle.)
-		 */
-		if (active_jobs == 0)
-			break;
-
-		/*
-		 * 2. Check of any quantums expired in the last time unit.
-		 */
-		if (scheme == RR)
-		{
-			for (i = 0; i < cores; i++)
-			{
-				if (quantum_clock[i] == 0)
-				{
-					for (j = 0; j < active_jobs; j++)
-					{
-						if (jobs[j].core_id == i)
-						{
-							// Notify the scheduler the quantum has expired
-							int core_id = jobs[j].core_id;
-							int old_job_id = jobs[j].job_id;
-							int new_job_id = scheduler_quantum_expired(jobs[j].core_id, time);
-
-							jobs[j].core_id = -1;
-
-							quantum_clock[core_id] = quantum;
-
-							// Set the new job
-							if ( new_job_id != -1 && !set_active_job(new_job_id, core_id, jobs, active_jobs) )
-							{
-								printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", new_job_id);
-								print_available_jobs(jobs, active_jobs);
-								return 3;
-							}
-							else
-							{
-								printf("Job %d, running on core %d, had its quantum expire. Core %d is now running job %d.\n", old_job_id, core_id, core_id, new_job_id);
-								printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-							}
-
-							break;
-						}
-					}
-				}
-			}
-		}
-
-
-		/*
-		 * 3. Check for any new jobs that arrive in this time unit
-		 */
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].arrival_time == time)
-			{
-				int new_job_core_id = scheduler_new_job(jobs[i].job_id, time, jobs[i].run_time, jobs[i].priority);
-				jobs[i].arrived = 1;
-				jobs_alive++;
-
-				if (new_job_core_id >= 0 && new_job_core_id < cores)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is now running on core %d.\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id, new_job_core_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-
-					// Find if anyone is currently using the core.
-					for (j = 0; j < active_jobs; j++)
-						if (jobs[j].core_id == new_job_core_id)
-							jobs[j].core_id = -1;
-
-					// Assign the core to the new job
-					jobs[i].core_id = new_job_core_id;
-
-					if (scheme == RR)
-						quantum_clock[new_job_core_id] = quantum;
-				}
-				else if (new_job_core_id == -1)
-				{
-					printf("A new job, job %d (running time=%d, priority=%d), arrived. Job %d is set to idle (-1).\n",
-							jobs[i].job_id, jobs[i].run_time, jobs[i].priority, jobs[i].job_id);
-					printf("  Queue: "); scheduler_show_queue(); printf("\n\n");
-				}
-				else
-				{
-					printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", new_job_core_id);
-					print_available_cores(cores);
-					return 3;
-				}
-			}
-		}
-
+		fprintf(stderr, "Unable to open file \"%s\".\n", record_file);
+		return 2;
+	}
 
-		/*
-		 * 4. Run the time unit.
-		 */
-		char time_string[cores][11];
-		int cores_working = 0;
+	int i;
+	simulator_output_t out;
+	out.quiet = quiet;
+	out.rle_diagram = rle_diagram;
+	out.job_stats = job_stats;
+	// Quiet mode never prints the diagram, so only build it when streaming
+	out.keep_timeline = !quiet || timing_stream != NULL;
+	out.timelines = malloc(cores * sizeof(timeline_t));
+	for (i = 0; i < cores; i++)
+		timeline_init(&out.timelines[i], i, timing_stream);
 
-		for (i = 0; i < cores; i++)
-			time_string[i][0] = '\0';
+	sim_hooks_t hooks = { on_time_started, on_job_finished, on_quantum_expired, on_job_arrived, on_time_ran, &out };
+	sim_t sim;
+	sim_init(&sim, s, scheme, quantum, cores, &trace, event_driven);
 
-		for (i = 0; i < active_jobs; i++)
-		{
-			if (jobs[i].core_id != -1)
-			{
-				cores_working++;
-				jobs[i].run_time--;
-				quantum_clock[jobs[i].core_id]--;
-
-				assert(time_string[jobs[i].core_id][0] == '\0');
-
-				if (jobs[i].job_id < 10)
-					sprintf(time_string[jobs[i].core_id], "%d", jobs[i].job_id);
-				else if (jobs[i].job_id < 10 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 + 'a');
-				else if (jobs[i].job_id < 10 + 26 + 26)
-					sprintf(time_string[jobs[i].core_id], "%c", jobs[i].job_id - 10 - 26 + 'A');
-				else
-					snprintf(time_string[jobs[i].core_id], 10, "(%d)", jobs[i].job_id);
-			}
-		}
-
-		for (i = 0; i < cores; i++)
+	if (!sim_run(&sim, &hooks))
+	{
+		switch (sim.error)
 		{
-			// If the core is idle, print a '-'
-			if (time_string[i][0] == '\0')
-				strcpy(time_string[i], "-");
-
-			// Ensure we have enough memory
-			while (strlen(core_timing_diagram[i]) + strlen(time_string[i]) >= (unsigned int)core_timing_diagram_size)
-			{
-				core_timing_diagram_size *= 2;
+			case SIM_BAD_FINISHED_JOB:
+				printf("The scheduler_job_finished() selected an invalid job (job_id == %d).\n", sim.error_value);
+				print_available_jobs(&sim);
+				break;
 
-				for (j = 0; j < cores; j++)
-				{
-					core_timing_diagram[j] = realloc(core_timing_diagram[j], core_timing_diagram_size + 1);
+			case SIM_BAD_EXPIRED_JOB:
+				printf("The scheduler_quantum_expired() selected an invalid job (job_id == %d).\n", sim.error_value);
+				print_available_jobs(&sim);
+				break;
 
-					if (core_timing_diagram[j] == NULL)
-					{
-						fprintf(stderr, "Out of memory.\n");
-						return 3;
-					}
-				}
-			}
+			case SIM_BAD_CORE:
+				printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", sim.error_value);
+				print_available_cores(cores);
+				break;
 
-			strcat( core_timing_diagram[i], time_string[i] );
+			default:
+				printf("All cores are idle and at least one job remains unscheduled.\n");
+				print_available_jobs(&sim);
+				break;
 		}
+		return 3;
+	}
 
 
-		/*
-		 * 5. Print data!
-		 */
-		printf("At the end of time unit %d...\n", time);
-
-		for (i = 0; i < cores; i++)
-			printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-		printf("\n");
+	if (!quiet)
+	{
+		printf("FINAL TIMING DIAGRAM:\n");
+		print_timing_diagram(out.timelines, cores, rle_diagram);
 
-		printf("  Queue: ");
-		scheduler_show_queue();
-		printf("\n");
 		printf("\n");
-
-
-		/*
-		 * 6. Sanity Checking
-		 *
-		 * - If there's a job alive (needing to be ran) and all CPUs are idle, the scheduler failed to schedule properly.
-		 */
-		if (jobs_alive > 0 && cores_working == 0)
-		{
-			printf("All cores are idle and at least one job remains unscheduled.\n");
-			print_available_jobs(jobs, active_jobs);
-			return 3;
-		}
-
-
-		/*
-		 * 7. Increase time
-		 */
-		time++;
+	}
+	printf("Average Waiting Time: %.2f\n", sched_average_waiting_time(s));
+	printf("Average Turnaround Time: %.2f\n", sched_average_turnaround_time(s));
+	printf("Average Response Time: %.2f\n", sched_average_response_time(s));
+	if (per_core)
+		printf("Migrations: %d\n", sched_migrations(s));
+	if (percentiles)
+	{
+		printf("Waiting Time p50/p90/p99/p99.9/max: %d/%d/%d/%d/%d\n",
+				sched_waiting_time_percentile(s, 50), sched_waiting_time_percentile(s, 90),
+				sched_waiting_time_percentile(s, 99), sched_waiting_time_percentile(s, 99.9),
+				sched_waiting_time_percentile(s, 100));
+		printf("Turnaround Time p50/p90/p99/p99.9/max: %d/%d/%d/%d/%d\n",
+				sched_turnaround_time_percentile(s, 50), sched_turnaround_time_percentile(s, 90),
+				sched_turnaround_time_percentile(s, 99), sched_turnaround_time_percentile(s, 99.9),
+				sched_turnaround_time_percentile(s, 100));
+		printf("Response Time p50/p90/p99/p99.9/max: %d/%d/%d/%d/%d\n",
+				sched_response_time_percentile(s, 50), sched_response_time_percentile(s, 90),
+				sched_response_time_percentile(s, 99), sched_response_time_percentile(s, 99.9),
+				sched_response_time_percentile(s, 100));
 	}
 
-
-	printf("FINAL TIMING DIAGRAM:\n");
-	for (i = 0; i < cores; i++)
-		printf("  Core %2d: %s\n", i, core_timing_diagram[i]);
-
-	printf("\n");
-	printf("Average Waiting Time: %.2f\n", scheduler_average_waiting_time());
-	printf("Average Turnaround Time: %.2f\n", scheduler_average_turnaround_time());
-	printf("Average Response Time: %.2f\n", scheduler_average_response_time());
-
-	scheduler_clean_up();
+	scheduler_destroy(s);
 
 
-	free(quantum_clock);
 	for (i=0; i < cores; i++)
-		free(core_timing_diagram[i]);
-	free(core_timing_diagram);
-	free(jobs);
+		timeline_free(&out.timelines[i]);
+	free(out.timelines);
+	if (timing_stream != NULL)
+		fclose(timing_stream);
+	if (job_stats != NULL)
+		fclose(job_stats);
+	sim_free(&sim);
+	sim_trace_free(&trace);
 
 	return 0;
 }
@@ -0,0 +1,254 @@
+/** @file sweep.c
+ *
+ * Runs every combination of trace, core count and scheme through the
+ * scheduler on a pool of threads and prints one table with the results.
+ * Each run owns a scheduler_t, so runs never share state. Runs go through
+ * the simulator's own loop (simulation.h) in event-driven mode, so they
+ * produce the same averages as "./simulator -q -e".
+ *
+ * Usage: ./sweep [-j threads] [-p] -c 1,2,4 -s fcfs,sjf,rr2 <trace> [trace...]
+ *
+ * -p gives each core its own run queue (see sched_use_per_core_queues()).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libscheduler/libscheduler.h"
+#include "simulation.h"
+
+#define MAX_LIST 64
+
+typedef struct
+{
+	char *file_name;
+	sim_trace_t trace;
+} sweep_trace_t;
+
+typedef struct
+{
+	char name[16];
+	scheme_t scheme;
+	int quantum;
+} sweep_scheme_t;
+
+typedef struct
+{
+	sweep_trace_t *trace;
+	int cores;
+	sweep_scheme_t *scheme;
+	int per_core;
+
+	int ok;
+	float waiting, turnaround, response;
+	int turnaround_p99, response_p99;
+	int makespan, migrations;
+	double wall_ms;
+} sweep_run_t;
+
+typedef struct
+{
+	sweep_run_t *runs;
+	int num_runs;
+	int next; /* next run to hand out, updated atomically */
+} sweep_pool_t;
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-j <threads>] [-p] -c <cores,...> -s <scheme,...> <input file> [input file...]\n", program_name);
+	fprintf(stderr, "       %s -j 4 -c 1,2,4 -s fcfs,sjf,rr2 examples/proc1.csv examples/proc2.csv\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq#, cfs#\n");
+	fprintf(stderr, "Threads default to the number of online processors. An input file of \"-\"\n");
+	fprintf(stderr, "reads a trace from stdin.\n");
+}
+
+double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+int parse_scheme(const char *text, sweep_scheme_t *out)
+{
+	snprintf(out->name, sizeof(out->name), "%s", text);
+	return sim_parse_scheme(text, &out->scheme, &out->quantum) == 1;
+}
+
+/*
+ * Simulates one configuration. Returns 0 if the scheduler made an invalid
+ * decision.
+ */
+int run_simulation(sweep_run_t *run)
+{
+	sim_t sim;
+	scheduler_t *s = scheduler_create(run->cores, run->scheme->scheme);
+	if (run->per_core)
+		sched_use_per_core_queues(s);
+
+	sim_init(&sim, s, run->scheme->scheme, run->scheme->quantum, run->cores, &run->trace->trace, 1);
+	run->ok = sim_run(&sim, NULL);
+	run->makespan = sim.time;
+	if (run->ok)
+	{
+		run->waiting = sched_average_waiting_time(s);
+		run->turnaround = sched_average_turnaround_time(s);
+		run->response = sched_average_response_time(s);
+		run->migrations = sched_migrations(s);
+		run->turnaround_p99 = sched_turnaround_time_percentile(s, 99);
+		run->response_p99 = sched_response_time_percentile(s, 99);
+	}
+
+	scheduler_destroy(s);
+	sim_free(&sim);
+
+	return run->ok;
+}
+
+void *worker(void *arg)
+{
+	sweep_pool_t *pool = (sweep_pool_t *)arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->num_runs)
+	{
+		double start = now_ms();
+		run_simulation(&pool->runs[i]);
+		pool->runs[i].wall_ms = now_ms() - start;
+	}
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, j, k;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int core_list[MAX_LIST], num_cores = 0;
+	sweep_scheme_t scheme_list[MAX_LIST];
+	int num_schemes = 0, per_core = 0;
+	char *token;
+
+	while ((c = getopt(argc, argv, "j:pc:s:")) != -1)
+	{
+		switch (c)
+		{
+			case 'j':
+				threads = atoi(optarg);
+				if (threads <= 0)
+				{
+					fprintf(stderr, "Option -j <threads> requires a positive number.\n");
+					return 1;
+				}
+				break;
+
+			case 'p':
+				per_core = 1;
+				break;
+
+			case 'c':
+				for (token = strtok(optarg, ","); token != NULL; token = strtok(NULL, ","))
+				{
+					if (num_cores == MAX_LIST || (core_list[num_cores] = atoi(token)) <= 0)
+					{
+						fprintf(stderr, "Option -c <cores,...> requires at most %d positive numbers.\n", MAX_LIST);
+						return 1;
+					}
+					num_cores++;
+				}
+				break;
+
+			case 's':
+				for (token = strtok(optarg, ","); token != NULL; token = strtok(NULL, ","))
+				{
+					if (num_schemes == MAX_LIST || !parse_scheme(token, &scheme_list[num_schemes]))
+					{
+						fprintf(stderr, "Unknown scheme \"%s\".\n", token);
+						print_usage(argv[0]);
+						return 1;
+					}
+					num_schemes++;
+				}
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (num_cores == 0 || num_schemes == 0 || optind == argc)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	int num_traces = argc - optind;
+	sweep_trace_t *traces = malloc(num_traces * sizeof(sweep_trace_t));
+	for (i = 0; i < num_traces; i++)
+	{
+		traces[i].file_name = argv[optind + i];
+		if (!sim_trace_load(&traces[i].trace, traces[i].file_name))
+			return 2;
+	}
+
+	sweep_pool_t pool;
+	pool.num_runs = num_traces * num_cores * num_schemes;
+	pool.runs = calloc(pool.num_runs, sizeof(sweep_run_t));
+	pool.next = 0;
+
+	sweep_run_t *run = pool.runs;
+	for (i = 0; i < num_traces; i++)
+		for (j = 0; j < num_cores; j++)
+			for (k = 0; k < num_schemes; k++, run++)
+			{
+				run->trace = &traces[i];
+				run->cores = core_list[j];
+				run->scheme = &scheme_list[k];
+				run->per_core = per_core;
+			}
+
+	if (threads > pool.num_runs)
+		threads = pool.num_runs;
+
+	double start = now_ms();
+	pthread_t *tids = malloc(threads * sizeof(pthread_t));
+	for (i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, worker, &pool);
+	for (i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	double total_ms = now_ms() - start;
+
+	int failed = 0;
+	printf("%-24s %5s %-6s %8s %10s %10s %10s %10s %10s %10s %10s %9s\n", "trace", "cores", "scheme", "jobs", "wait",
+			"turnaround", "tat p99", "response", "resp p99", "makespan", "migrations", "wall ms");
+	for (i = 0; i < pool.num_runs; i++)
+	{
+		run = &pool.runs[i];
+		if (run->ok)
+			printf("%-24s %5d %-6s %8d %10.2f %10.2f %10d %10.2f %10d %10d %10d %9.2f\n", run->trace->file_name,
+					run->cores, run->scheme->name, run->trace->trace.num_jobs, run->waiting, run->turnaround,
+					run->turnaround_p99, run->response, run->response_p99, run->makespan, run->migrations,
+					run->wall_ms);
+		else
+		{
+			printf("%-24s %5d %-6s %8d  scheduler made an invalid decision at time %d\n", run->trace->file_name,
+					run->cores, run->scheme->name, run->trace->trace.num_jobs, run->makespan);
+			failed = 1;
+		}
+	}
+	printf("\n%d run(s) on %d thread(s) in %.2f ms\n", pool.num_runs, threads, total_ms);
+
+	for (i = 0; i < num_traces; i++)
+		sim_trace_free(&traces[i].trace);
+	free(traces);
+	free(pool.runs);
+	free(tids);
+
+	return failed ? 3 : 0;
+}
@@ -0,0 +1,610 @@
+/** @file threadrun.c
+ *
+ * Runs a trace on real threads instead of a simulated clock. Each "core" is
+ * a worker thread pinned to a CPU (core i runs on CPU i modulo the number
+ * of online CPUs). A dispatcher thread owns the scheduler_t and turns its
+ * decisions into work handed to the workers:
+ *
+ *   ./threadrun -c 4 -s rr2 -u 500 -w 256 examples/proc3.csv
+ *   ./simulator -q -e -c 4 -s rr2 examples/proc3.csv    (the prediction)
+ *
+ * One time unit of a job is a fixed amount of work: a walk over the job's
+ * own working set (-w KiB), sized at start-up so that a unit takes -u
+ * microseconds with a warm cache. The clock handed to the scheduler is
+ * wall time in those units, so the averages can be set against the
+ * simulator's directly.
+ *
+ * Preemption is cooperative. A worker checks its assignment between units,
+ * so a preempted job stops within one unit. At the end of a quantum the
+ * worker reports to the dispatcher and waits for the decision, as it does
+ * when a job finishes. Jobs never run on two workers at once: a worker
+ * that picks up a job still finishing its unit elsewhere waits for it.
+ *
+ * Besides the averages it reports how long scheduler calls take, how long
+ * a worker waits between a decision and picking it up, and how much longer
+ * the first unit after a switch takes than the units that follow (the cost
+ * of refilling the cache).
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "libscheduler/libscheduler.h"
+#include "libscheduler/histogram.h"
+#include "simulation.h"
+
+#define CACHE_LINE 64
+
+typedef enum { EVENT_NONE = 0, EVENT_FINISHED, EVENT_QUANTUM } event_kind_t;
+
+typedef struct
+{
+	int job_id, arrival_time, run_time, priority;
+	int remaining;       /* units left; only the owner touches it */
+	int owner;           /* core running the job, or -1 */
+	int last_core;
+	int finished;        /* set by the dispatcher once reported */
+	size_t cursor;       /* next cache line of data to touch */
+	unsigned char *data; /* working set, allocated on first run */
+} threadrun_job_t;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	int generation;     /* bumped by the dispatcher on every assignment */
+	int slot;           /* job the scheduler put on this core, or -1 */
+	double assigned_ns; /* when generation last changed */
+	int stop;
+
+	/* Posted by the worker under the dispatcher's lock */
+	event_kind_t event;
+	int event_generation;
+
+	pthread_t thread;
+	int core_id, cpu;
+	struct _threadrun_t *run;
+
+	/* Owned by the worker */
+	histogram_t pickup_us, first_unit_ns, unit_ns; /* pickups can wait seconds, so in us */
+	long long switches, migrations;
+	double busy_ns;
+} __attribute__((aligned(CACHE_LINE))) threadrun_core_t;
+
+typedef struct _threadrun_t
+{
+	threadrun_job_t *jobs; /* sorted by arrival */
+	const int *slot_of;    /* job_id -> slot, owned by the trace */
+	int num_jobs;
+	threadrun_core_t *cores;
+	int num_cores, quantum;
+
+	double start_ns, unit_ns;
+	long touches_per_unit;
+	size_t lines; /* cache lines in a working set */
+
+	pthread_mutex_t events_lock;
+	pthread_cond_t events_posted;
+	int pending;
+} threadrun_t;
+
+void print_usage(char *program_name)
+{
+	fprintf(stderr, "Usage: %s [-p] [-u <unit us>] [-w <working set KiB>] [-R <file>] -c <cores> -s <scheme> <input file>\n", program_name);
+	fprintf(stderr, "       %s -c 2 -s rr2 -u 500 examples/proc1.csv\n", program_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Acceptable schemes are: fcfs, sjf, psjf, pri, ppri, rr#, mlfq#, cfs#\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "  -u  length of one time unit in microseconds, with a warm cache (default 1000)\n");
+	fprintf(stderr, "  -w  working set each job walks, in KiB (default 64)\n");
+	fprintf(stderr, "  -p  give every core its own run queue, with work stealing\n");
+	fprintf(stderr, "  -R  record every scheduler call and its result to <file> for ./replay\n");
+}
+
+double now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * One time unit of work: touch the next touches cache lines of the
+ * working set, wrapping around, and carry on from there next time.
+ */
+void run_unit(unsigned char *data, size_t *cursor, size_t lines, long touches)
+{
+	size_t line = *cursor;
+	long i;
+
+	for (i = 0; i < touches; i++)
+	{
+		data[line * CACHE_LINE]++;
+		if (++line == lines)
+			line = 0;
+	}
+
+	*cursor = line;
+}
+
+/*
+ * Sizes a unit so it takes unit_ns on a warm working set.
+ */
+long calibrate(size_t lines, double unit_ns)
+{
+	unsigned char *data = aligned_alloc(CACHE_LINE, lines * CACHE_LINE);
+	size_t cursor = 0;
+	long touches = 1 << 16;
+
+	memset(data, 0, lines * CACHE_LINE);
+	run_unit(data, &cursor, lines, lines * 4);
+
+	// Double until a batch takes long enough to time reliably
+	for (;;)
+	{
+		double start = now_ns();
+		run_unit(data, &cursor, lines, touches);
+		double elapsed = now_ns() - start;
+
+		if (elapsed > 20e6 || touches > (1L << 40))
+		{
+			free(data);
+			long per_unit = (long)(touches * (unit_ns / elapsed));
+			return per_unit > 0 ? per_unit : 1;
+		}
+		touches *= 2;
+	}
+}
+
+/*
+ * Reports an event for the assignment with the given generation. The
+ * dispatcher ignores it if it has moved the core on in the meantime.
+ */
+void post_event(threadrun_core_t *core, event_kind_t kind, int generation)
+{
+	threadrun_t *run = core->run;
+
+	pthread_mutex_lock(&run->events_lock);
+	if (core->event == EVENT_NONE)
+		run->pending++;
+	core->event = kind;
+	core->event_generation = generation;
+	pthread_cond_signal(&run->events_posted);
+	pthread_mutex_unlock(&run->events_lock);
+}
+
+void *worker(void *arg)
+{
+	threadrun_core_t *core = (threadrun_core_t *)arg;
+	threadrun_t *run = core->run;
+	int generation = 0, slot, stop;
+	double assigned_ns;
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(core->cpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+	for (;;)
+	{
+		// Wait for a new assignment
+		pthread_mutex_lock(&core->lock);
+		while (core->generation == generation && !core->stop)
+			pthread_cond_wait(&core->changed, &core->lock);
+		generation = core->generation;
+		slot = core->slot;
+		assigned_ns = core->assigned_ns;
+		stop = core->stop;
+		pthread_mutex_unlock(&core->lock);
+
+		if (stop)
+			break;
+
+		histogram_record(&core->pickup_us, (int)((now_ns() - assigned_ns) / 1e3));
+		if (slot == -1)
+			continue;
+
+		threadrun_job_t *job = &run->jobs[slot];
+
+		// The previous owner may still be finishing its unit
+		int free_owner = -1;
+		while (!__atomic_compare_exchange_n(&job->owner, &free_owner, core->core_id, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			free_owner = -1;
+			sched_yield();
+		}
+
+		if (job->data == NULL && job->remaining > 0)
+		{
+			job->data = aligned_alloc(CACHE_LINE, run->lines * CACHE_LINE);
+			memset(job->data, 0, run->lines * CACHE_LINE);
+		}
+		if (job->last_core != core->core_id)
+		{
+			if (job->last_core != -1)
+				core->migrations++;
+			job->last_core = core->core_id;
+		}
+		core->switches++;
+
+		int units = 0;
+		event_kind_t event = EVENT_NONE;
+
+		while (job->remaining > 0)
+		{
+			double start = now_ns();
+			run_unit(job->data, &job->cursor, run->lines, run->touches_per_unit);
+			double elapsed = now_ns() - start;
+
+			histogram_record(units == 0 ? &core->first_unit_ns : &core->unit_ns, (int)elapsed);
+			core->busy_ns += elapsed;
+			job->remaining--;
+			units++;
+
+			if (job->remaining == 0)
+				break;
+			if (run->quantum > 0 && units == run->quantum)
+			{
+				event = EVENT_QUANTUM;
+				break;
+			}
+			if (__atomic_load_n(&core->generation, __ATOMIC_RELAXED) != generation)
+				break;
+		}
+
+		if (job->remaining == 0)
+		{
+			free(job->data);
+			job->data = NULL;
+			event = EVENT_FINISHED;
+		}
+
+		__atomic_store_n(&job->owner, -1, __ATOMIC_RELEASE);
+
+		if (event != EVENT_NONE)
+			post_event(core, event, generation);
+	}
+
+	return NULL;
+}
+
+/*
+ * Hands slot (or nothing, for -1) to a core.
+ */
+void assign(threadrun_core_t *core, int slot)
+{
+	pthread_mutex_lock(&core->lock);
+	core->slot = slot;
+	core->assigned_ns = now_ns();
+	__atomic_store_n(&core->generation, core->generation + 1, __ATOMIC_RELAXED);
+	pthread_cond_signal(&core->changed);
+	pthread_mutex_unlock(&core->lock);
+}
+
+void print_latency(const char *name, histogram_t *h, double scale, const char *unit)
+{
+	printf("%s p50/p99/max: %.1f/%.1f/%.1f %s\n", name, histogram_percentile(h, 50) / scale,
+			histogram_percentile(h, 99) / scale, histogram_percentile(h, 100) / scale, unit);
+}
+
+/*
+ * Merges the histograms of every core into the first argument.
+ */
+void histogram_merge(histogram_t *into, histogram_t *from)
+{
+	int i;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+		into->counts[i] += from->counts[i];
+	into->total += from->total;
+	if (from->max > into->max)
+		into->max = from->max;
+}
+
+int main(int argc, char **argv)
+{
+	int c, i;
+	int cores = 0, quantum = 0, per_core = 0;
+	scheme_t scheme = FCFS;
+	int have_scheme = 0;
+	double unit_us = 1000;
+	long working_set_kib = 64;
+	char *record_file = NULL;
+
+	while ((c = getopt(argc, argv, "c:s:u:w:pR:")) != -1)
+	{
+		switch (c)
+		{
+			case 'c':
+				cores = atoi(optarg);
+				if (cores <= 0)
+				{
+					fprintf(stderr, "Option -c <cores> require a positive number.\n");
+					return 1;
+				}
+				break;
+
+			case 's':
+				if (sim_parse_scheme(optarg, &scheme, &quantum) != 1)
+				{
+					fprintf(stderr, "Unknown scheme \"%s\".\n", optarg);
+					print_usage(argv[0]);
+					return 1;
+				}
+				have_scheme = 1;
+				break;
+
+			case 'u':
+				unit_us = atof(optarg);
+				if (unit_us <= 0)
+				{
+					fprintf(stderr, "Option -u <unit us> requires a positive number.\n");
+					return 1;
+				}
+				break;
+
+			case 'w':
+				working_set_kib = atol(optarg);
+				if (working_set_kib <= 0)
+				{
+					fprintf(stderr, "Option -w <working set KiB> requires a positive number.\n");
+					return 1;
+				}
+				break;
+
+			case 'p':
+				per_core = 1;
+				break;
+
+			case 'R':
+				record_file = optarg;
+				break;
+
+			default:
+				print_usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (cores == 0 || !have_scheme || optind != argc - 1)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	/*
+	 * Load the trace.
+	 */
+	threadrun_t run;
+	sim_trace_t trace;
+	if (!sim_trace_load(&trace, argv[optind]))
+		return 2;
+
+	run.num_jobs = trace.num_jobs;
+	run.slot_of = trace.slot_of;
+	run.jobs = malloc((trace.num_jobs > 0 ? trace.num_jobs : 1) * sizeof(threadrun_job_t));
+	for (i = 0; i < trace.num_jobs; i++)
+	{
+		threadrun_job_t *job = &run.jobs[i];
+		job->job_id = trace.jobs[i].job_id;
+		job->arrival_time = trace.jobs[i].arrival_time;
+		job->run_time = trace.jobs[i].run_time;
+		job->priority = trace.jobs[i].priority;
+		job->remaining = job->run_time;
+		job->owner = job->last_core = -1;
+		job->finished = 0;
+		job->cursor = 0;
+		job->data = NULL;
+	}
+
+	run.num_cores = cores;
+	run.quantum = quantum;
+	run.unit_ns = unit_us * 1e3;
+	run.lines = (working_set_kib * 1024 + CACHE_LINE - 1) / CACHE_LINE;
+	run.touches_per_unit = calibrate(run.lines, run.unit_ns);
+	run.pending = 0;
+
+	pthread_condattr_t monotonic;
+	pthread_condattr_init(&monotonic);
+	pthread_condattr_setclock(&monotonic, CLOCK_MONOTONIC);
+	pthread_mutex_init(&run.events_lock, NULL);
+	pthread_cond_init(&run.events_posted, &monotonic);
+
+	/*
+	 * Start the workers.
+	 */
+	int num_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	run.cores = aligned_alloc(CACHE_LINE, cores * sizeof(threadrun_core_t));
+	memset(run.cores, 0, cores * sizeof(threadrun_core_t));
+
+	for (i = 0; i < cores; i++)
+	{
+		threadrun_core_t *core = &run.cores[i];
+		pthread_mutex_init(&core->lock, NULL);
+		pthread_cond_init(&core->changed, NULL);
+		core->slot = -1;
+		core->core_id = i;
+		core->cpu = i % num_cpus;
+		core->run = &run;
+		histogram_init(&core->pickup_us);
+		histogram_init(&core->first_unit_ns);
+		histogram_init(&core->unit_ns);
+		pthread_create(&core->thread, NULL, worker, core);
+	}
+
+	printf("Running %d job(s) on %d pinned worker thread(s) over %d CPU(s), 1 time unit = %.0f us, %ld KiB per job\n\n",
+			run.num_jobs, cores, num_cpus < cores ? num_cpus : cores, unit_us, working_set_kib);
+
+	/*
+	 * Dispatch. The order within a round matches the simulator: finished
+	 * jobs, then quantum expiry, then arrivals.
+	 */
+	scheduler_t *s = scheduler_create(cores, scheme);
+	if (per_core)
+		sched_use_per_core_queues(s);
+	if (record_file != NULL && sched_record(s, record_file) != 0)
+	{
+		fprintf(stderr, "Unable to open file \"%s\".\n", record_file);
+		return 2;
+	}
+
+	histogram_t decision_ns;
+	histogram_init(&decision_ns);
+
+	event_kind_t *events = malloc(cores * sizeof(event_kind_t));
+	int *event_generations = malloc(cores * sizeof(int));
+	int next_arrival = 0, finished = 0, failed = 0, time = 0;
+
+	run.start_ns = now_ns();
+
+	while (finished < run.num_jobs && !failed)
+	{
+		pthread_mutex_lock(&run.events_lock);
+		while (run.pending == 0)
+		{
+			if (next_arrival == run.num_jobs)
+			{
+				pthread_cond_wait(&run.events_posted, &run.events_lock);
+				continue;
+			}
+
+			double deadline = run.start_ns + run.jobs[next_arrival].arrival_time * run.unit_ns;
+			if (now_ns() >= deadline)
+				break;
+
+			struct timespec until = { (time_t)(deadline / 1e9), (long)(deadline - (long long)(deadline / 1e9) * 1e9) };
+			pthread_cond_timedwait(&run.events_posted, &run.events_lock, &until);
+		}
+		for (i = 0; i < cores; i++)
+		{
+			events[i] = run.cores[i].event;
+			event_generations[i] = run.cores[i].event_generation;
+			run.cores[i].event = EVENT_NONE;
+		}
+		run.pending = 0;
+		pthread_mutex_unlock(&run.events_lock);
+
+		double now = now_ns();
+		time = (int)((now - run.start_ns) / run.unit_ns);
+
+		int pass;
+		for (pass = EVENT_FINISHED; pass <= EVENT_QUANTUM && !failed; pass++)
+		{
+			for (i = 0; i < cores && !failed; i++)
+			{
+				threadrun_core_t *core = &run.cores[i];
+
+				// Stale: the core was given something else after the event
+				if (events[i] != (event_kind_t)pass || event_generations[i] != core->generation)
+					continue;
+
+				int new_job_id;
+				double start = now_ns();
+				if (pass == EVENT_FINISHED)
+					new_job_id = sched_job_finished(s, i, run.jobs[core->slot].job_id, time);
+				else
+					new_job_id = sched_quantum_expired(s, i, time);
+				histogram_record(&decision_ns, (int)(now_ns() - start));
+
+				if (pass == EVENT_FINISHED)
+				{
+					run.jobs[core->slot].finished = 1;
+					finished++;
+				}
+
+				int slot = new_job_id >= 0 && new_job_id < run.num_jobs ? run.slot_of[new_job_id] : -1;
+				if (new_job_id != -1 && (slot == -1 || slot >= next_arrival || run.jobs[slot].finished))
+				{
+					printf("The scheduler selected an invalid job (job_id == %d).\n", new_job_id);
+					failed = 1;
+					break;
+				}
+
+				assign(core, slot);
+			}
+		}
+
+		while (!failed && next_arrival < run.num_jobs &&
+				run.start_ns + run.jobs[next_arrival].arrival_time * run.unit_ns <= now)
+		{
+			threadrun_job_t *job = &run.jobs[next_arrival++];
+
+			double start = now_ns();
+			int core_id = sched_new_job(s, job->job_id, time, job->run_time, job->priority);
+			histogram_record(&decision_ns, (int)(now_ns() - start));
+
+			if (core_id >= 0 && core_id < cores)
+				assign(&run.cores[core_id], next_arrival - 1);
+			else if (core_id != -1)
+			{
+				printf("The scheduler_new_job() selected an invalid core (core_id == %d).\n", core_id);
+				failed = 1;
+			}
+		}
+	}
+
+	double elapsed_ns = now_ns() - run.start_ns;
+
+	for (i = 0; i < cores; i++)
+	{
+		pthread_mutex_lock(&run.cores[i].lock);
+		run.cores[i].stop = 1;
+		pthread_cond_signal(&run.cores[i].changed);
+		pthread_mutex_unlock(&run.cores[i].lock);
+		pthread_join(run.cores[i].thread, NULL);
+	}
+
+	if (!failed)
+	{
+		histogram_t pickup, first_unit, unit;
+		long long switches = 0, migrations = 0;
+		double busy_ns = 0;
+
+		histogram_init(&pickup);
+		histogram_init(&first_unit);
+		histogram_init(&unit);
+		for (i = 0; i < cores; i++)
+		{
+			histogram_merge(&pickup, &run.cores[i].pickup_us);
+			histogram_merge(&first_unit, &run.cores[i].first_unit_ns);
+			histogram_merge(&unit, &run.cores[i].unit_ns);
+			switches += run.cores[i].switches;
+			migrations += run.cores[i].migrations;
+			busy_ns += run.cores[i].busy_ns;
+		}
+
+		printf("Average Waiting Time: %.2f\n", sched_average_waiting_time(s));
+		printf("Average Turnaround Time: %.2f\n", sched_average_turnaround_time(s));
+		printf("Average Response Time: %.2f\n", sched_average_response_time(s));
+		printf("Makespan: %d time units (%.2f ms)\n", time, elapsed_ns / 1e6);
+		printf("Dispatches: %lld, migrations: %lld, workers busy %.1f%% of the time\n", switches, migrations,
+				100.0 * busy_ns / (elapsed_ns * cores));
+		print_latency("Scheduler call", &decision_ns, 1, "ns");
+		print_latency("Decision to pickup", &pickup, 1, "us");
+		print_latency("First unit after a switch", &first_unit, 1e3, "us");
+		print_latency("Following units", &unit, 1e3, "us");
+	}
+
+	scheduler_destroy(s);
+	for (i = 0; i < cores; i++)
+	{
+		pthread_mutex_destroy(&run.cores[i].lock);
+		pthread_cond_destroy(&run.cores[i].changed);
+	}
+	for (i = 0; i < run.num_jobs; i++)
+		free(run.jobs[i].data);
+	free(run.cores);
+	free(events);
+	free(event_generations);
+	free(run.jobs);
+	sim_trace_free(&trace);
+
+	return failed ? 3 : 0;
+}
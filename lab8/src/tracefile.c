@@ -0,0 +1,210 @@
+/** @file tracefile.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracefile.h"
+
+/*
+  Reads all of fd into a malloc'd buffer, for input that cannot be mapped
+  (pipes). Returns NULL if reading fails.
+ */
+static char *read_all(int fd, size_t *size)
+{
+  size_t capacity = 1 << 20, used = 0;
+  char *buffer = malloc(capacity);
+  ssize_t got;
+
+  while ((got = read(fd, buffer + used, capacity - used)) > 0)
+  {
+    used += got;
+    if (used == capacity)
+    {
+      capacity *= 2;
+      buffer = realloc(buffer, capacity);
+    }
+  }
+
+  if (got < 0)
+  {
+    free(buffer);
+    return NULL;
+  }
+
+  *size = used;
+  return buffer;
+}
+
+/*
+  Parses an integer the way atoi() does, without locale or errno
+  handling, and leaves *p after the last character used.
+ */
+static int parse_int(const char **p, const char *end)
+{
+  const char *s = *p;
+  int negative = 0, value = 0;
+
+  while (s < end && (*s == ' ' || *s == '\t' || *s == '"'))
+    s++;
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+  while (s < end && *s >= '0' && *s <= '9')
+    value = value * 10 + (*s++ - '0');
+
+  *p = s;
+  return negative ? -value : value;
+}
+
+/*
+  Parses CSV text. The first line is a header and is skipped, as are empty
+  lines. Returns NULL if a line has fewer than three fields.
+ */
+static trace_record_t *parse_csv(const char *text, size_t size, int *count)
+{
+  const char *end = text + size;
+  const char *line = memchr(text, '\n', size);
+  int lines = 0, n = 0;
+
+  // Count lines first so the array is allocated once, at its final size
+  for (const char *p = text; p < end && (p = memchr(p, '\n', end - p)) != NULL; p++)
+    lines++;
+
+  trace_record_t *records = malloc((lines + 1) * sizeof(trace_record_t));
+
+  line = line != NULL ? line + 1 : end;
+  while (line < end)
+  {
+    const char *eol = memchr(line, '\n', end - line);
+    if (eol == NULL)
+      eol = end;
+
+    const char *p = line;
+    while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+      p++;
+
+    if (p < eol)
+    {
+      int fields[3], f;
+
+      for (f = 0; f < 3; f++)
+      {
+        fields[f] = parse_int(&p, eol);
+        while (p < eol && *p != ',')
+          p++;
+        if (f < 2)
+        {
+          if (p == eol)
+            break;
+          p++;
+        }
+      }
+
+      if (f < 3)
+      {
+        free(records);
+        return NULL;
+      }
+
+      records[n].arrival_time = fields[0];
+      records[n].run_time = fields[1];
+      records[n].priority = fields[2];
+      n++;
+    }
+
+    line = eol + 1;
+  }
+
+  *count = n;
+  return records;
+}
+
+/*
+  Copies the records of a binary trace. Returns NULL if the file is
+  shorter than its header says, or holds more jobs than an int can count.
+ */
+static trace_record_t *parse_binary(const char *data, size_t size, int *count)
+{
+  trace_header_t header;
+
+  memcpy(&header, data, sizeof(header));
+  if (header.count > INT_MAX ||
+      size < sizeof(header) + (size_t)header.count * sizeof(trace_record_t))
+    return NULL;
+
+  trace_record_t *records = malloc(((size_t)header.count + 1) * sizeof(trace_record_t));
+  memcpy(records, data + sizeof(header), (size_t)header.count * sizeof(trace_record_t));
+
+  *count = header.count;
+  return records;
+}
+
+/**
+  Loads a job trace, either CSV or binary (see TRACE_MAGIC). Regular files
+  are mapped and parsed in one pass; "-" reads stdin.
+
+  @param file_name the path of the trace, or "-" for stdin
+  @param count set to the number of jobs loaded
+  @return a malloc'd array of count records
+  @return NULL if the file cannot be read or is malformed; a message has
+          been printed to stderr
+ */
+trace_record_t *trace_load(const char *file_name, int *count)
+{
+  int fd = strcmp(file_name, "-") == 0 ? STDIN_FILENO : open(file_name, O_RDONLY);
+  struct stat st;
+  char *data = NULL;
+  size_t size = 0;
+  int mapped = 0;
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Unable to open file \"%s\".\n", file_name);
+    return NULL;
+  }
+
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    size = st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED)
+    {
+      mapped = 1;
+      madvise(data, size, MADV_SEQUENTIAL);
+    }
+  }
+
+  if (!mapped)
+    data = read_all(fd, &size);
+
+  if (fd != STDIN_FILENO)
+    close(fd);
+
+  if (data == NULL)
+  {
+    fprintf(stderr, "Unable to read file \"%s\".\n", file_name);
+    return NULL;
+  }
+
+  trace_record_t *records;
+  if (size >= sizeof(trace_header_t) && memcmp(data, TRACE_MAGIC, 8) == 0)
+    records = parse_binary(data, size, count);
+  else
+    records = parse_csv(data, size, count);
+
+  if (mapped)
+    munmap(data, size);
+  else
+    free(data);
+
+  if (records == NULL)
+    fprintf(stderr, "Illegal file format.\n");
+
+  return records;
+}
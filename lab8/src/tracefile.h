@@ -0,0 +1,32 @@
+/** @file tracefile.h
+ */
+
+#ifndef TRACEFILE_H_
+#define TRACEFILE_H_
+
+#include <stdint.h>
+
+/**
+  A binary trace starts with trace_header_t, followed by count
+  trace_record_t in native byte order. Anything else is read as CSV: one
+  header line, then "arrival,run,priority" per line.
+*/
+#define TRACE_MAGIC "JOBTRC01"
+
+typedef struct
+{
+  char magic[8];
+  uint32_t count;
+  uint32_t reserved;
+} trace_header_t;
+
+typedef struct
+{
+  int32_t arrival_time;
+  int32_t run_time;
+  int32_t priority;
+} trace_record_t;
+
+trace_record_t *trace_load(const char *file_name, int *count);
+
+#endif /* TRACEFILE_H_ */
@@ -2,92 +2,475 @@
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
 
-#define MAXSTR 1000
+#include "replace.h"
+#include "pagetable.h"
+#include "tlb.h"
+#include "tracefile.h"
+#include "mm.h"
+
+/* Addresses are read from the trace this many at a time */
+#define BATCH 4096
+
+/* Without -t, page numbers up to this wide get a flat table */
+#define DEFAULT_FLAT_BITS 24
+
+/* The replacer numbers frames with unsigned ints; a larger physical memory
+   only has its first MAX_FRAMES frames used */
+#define MAX_FRAMES (1ULL << 30)
+
+/* Access times in ns for the effective access time */
+#define DEFAULT_TLB_NS 1.0
+#define DEFAULT_MEMORY_NS 100.0
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-q] [-p policy] [-f frames] [-t table] [-T entries [-W ways] [-R lru|random]\n", prog);
+  fprintf(stderr, "       [-A] [-E tlb_ns,memory_ns]] < input\n");
+  fprintf(stderr, "       %s -B output < input\n", prog);
+  fprintf(stderr, "  -q  print only the summary, not each translation\n");
+  fprintf(stderr, "  -p  page replacement policy: fifo, lru, clock, second-chance (sc),\n");
+  fprintf(stderr, "      arc or opt (belady); the default is fifo\n");
+  fprintf(stderr, "  -f  number of frames, instead of the physical address space size\n");
+  fprintf(stderr, "  -t  page table: flat, radix2, radix3, radix4, inverted or hashed; the\n");
+  fprintf(stderr, "      default is flat for page numbers of up to %d bits, else radix4\n", DEFAULT_FLAT_BITS);
+  fprintf(stderr, "  -T  put a TLB of this many entries in front of the page table\n");
+  fprintf(stderr, "  -W  TLB associativity; the default is fully associative\n");
+  fprintf(stderr, "  -R  TLB replacement: lru (the default) or random\n");
+  fprintf(stderr, "  -A  tag TLB entries with ASIDs instead of flushing on a switch\n");
+  fprintf(stderr, "  -E  TLB and memory access times for the effective access time;\n");
+  fprintf(stderr, "      the default is %g,%g\n", DEFAULT_TLB_NS, DEFAULT_MEMORY_NS);
+  fprintf(stderr, "  -B  write the input as a binary trace (see tracefile.h), which loads\n");
+  fprintf(stderr, "      faster, and exit\n");
+  fprintf(stderr, "With -q, -p, -f, -t or -T, or a trace tagged with process ids (see\n");
+  fprintf(stderr, "tracefile.h), a summary of faults, hits and page table memory follows the\n");
+  fprintf(stderr, "translations.\n");
+}
+
+/* Reads the addresses that follow the header, for OPT, which has to know
+   the future. */
+static unsigned long long *read_addresses(trace_t *trace, long long *count)
+{
+  long long capacity = BATCH, n = 0;
+  unsigned long long *addrs = (unsigned long long *)malloc(capacity * sizeof(unsigned long long));
+  long got;
+
+  while ((got = trace_read(trace, addrs + n, BATCH)) > 0)
+  {
+    n += got;
+    if (capacity - n < BATCH)
+    {
+      capacity *= 2;
+      addrs = (unsigned long long *)realloc(addrs, capacity * sizeof(unsigned long long));
+    }
+  }
+
+  *count = n;
+  return addrs;
+}
 
 int main(int argc, char *argv[])
 {
-  char line[MAXSTR];
-  int *page_table, *mem_map;
-  unsigned int log_size, phy_size, page_size, d;
-  unsigned int num_pages, num_frames;
-  unsigned int offset, logical_addr, physical_addr, page_num, frame_num;
+  trace_t *trace;
+  trace_header_t header;
+  page_table_t *page_table;
+  unsigned int log_size, phy_size, page_size;
+  unsigned long long num_pages, num_frames;
+  unsigned long long offset, logical_addr, physical_addr, page_num;
+  unsigned int frame_num;
+  policy_t policy = POLICY_FIFO;
+  pt_kind_t pt_kind = PT_FLAT;
+  unsigned int pt_levels = 4;
+  long long frames_override = 0;
+  int summary = 0, quiet = 0, pt_chosen = 0, tagged, c;
+  const char *save_file = NULL;
+  long long tlb_entries = 0, tlb_ways = 0;
+  tlb_policy_t tlb_policy = TLB_LRU;
+  int tlb_tagged = 0;
+  double tlb_ns = DEFAULT_TLB_NS, memory_ns = DEFAULT_MEMORY_NS;
+
+  while ((c = getopt(argc, argv, "qp:f:t:T:W:R:AE:B:")) != -1)
+  {
+    switch (c)
+    {
+    case 'q':
+      quiet = 1;
+      summary = 1;
+      break;
+    case 'B':
+      save_file = optarg;
+      break;
+    case 'p':
+      if (!policy_parse(optarg, &policy))
+      {
+        fprintf(stderr, "Unknown policy \"%s\".\n", optarg);
+        usage(argv[0]);
+        exit(-1);
+      }
+      summary = 1;
+      break;
+    case 'f':
+      frames_override = atoll(optarg);
+      if (frames_override <= 0 || frames_override > (1LL << 30))
+      {
+        fprintf(stderr, "Option -f needs a positive number of frames.\n");
+        exit(-1);
+      }
+      summary = 1;
+      break;
+    case 't':
+      if (!pt_parse(optarg, &pt_kind, &pt_levels))
+      {
+        fprintf(stderr, "Unknown page table \"%s\".\n", optarg);
+        usage(argv[0]);
+        exit(-1);
+      }
+      pt_chosen = 1;
+      summary = 1;
+      break;
+    case 'T':
+      tlb_entries = atoll(optarg);
+      if (tlb_entries <= 0 || tlb_entries > (1LL << 24))
+      {
+        fprintf(stderr, "Option -T needs a positive number of TLB entries.\n");
+        exit(-1);
+      }
+      summary = 1;
+      break;
+    case 'W':
+      tlb_ways = atoll(optarg);
+      if (tlb_ways <= 0)
+      {
+        fprintf(stderr, "Option -W needs a positive number of ways.\n");
+        exit(-1);
+      }
+      break;
+    case 'R':
+      if (!tlb_parse_policy(optarg, &tlb_policy))
+      {
+        fprintf(stderr, "Unknown TLB replacement \"%s\".\n", optarg);
+        usage(argv[0]);
+        exit(-1);
+      }
+      break;
+    case 'A':
+      tlb_tagged = 1;
+      break;
+    case 'E':
+      if (sscanf(optarg, "%lf,%lf", &tlb_ns, &memory_ns) != 2 || tlb_ns < 0 || memory_ns < 0)
+      {
+        fprintf(stderr, "Option -E needs two access times, as in 1,100.\n");
+        exit(-1);
+      }
+      break;
+    default:
+      usage(argv[0]);
+      exit(-1);
+    }
+  }
 
   /* Get the memory characteristics from the input file */
-  fgets(line, MAXSTR, stdin);
-  if ((sscanf(line, "Logical address space size: %d^%d", &d, &log_size)) != 2)
+  trace = trace_open(STDIN_FILENO, &header);
+  if (trace == NULL)
+    exit(-1);
+  log_size = header.log_size;
+  phy_size = header.phy_size;
+  page_size = header.page_size;
+  tagged = (header.flags & TRACE_TAGGED) != 0;
+
+  if (save_file != NULL)
   {
-    fprintf(stderr, "Unexpected line 1. Abort.\n");
+    long long saved = trace_save(trace, &header, save_file);
+
+    if (saved < 0)
+    {
+      fprintf(stderr, "Unable to write \"%s\".\n", save_file);
+      exit(-1);
+    }
+    printf("Saved %lld addresses to %s\n", saved, save_file);
+    trace_close(trace);
+    return 0;
+  }
+  if (log_size > 64 || page_size > log_size || page_size > 63 || log_size - page_size > 63 || phy_size < page_size)
+  {
+    fprintf(stderr, "Unsupported address space sizes. Abort.\n");
     exit(-1);
   }
-  fgets(line, MAXSTR, stdin);
-  if ((sscanf(line, "Physical address space size: %d^%d", &d, &phy_size)) != 2)
+  num_pages = 1ULL << (log_size - page_size);
+  num_frames = frames_override > 0 ? (unsigned long long)frames_override
+                                   : phy_size - page_size > 63 ? MAX_FRAMES : 1ULL << (phy_size - page_size);
+
+  fprintf(stdout, "Number of Pages: %llu, Number of Frames: %llu\n\n", num_pages, num_frames);
+  if (num_frames > MAX_FRAMES)
+    num_frames = MAX_FRAMES;
+
+  /* Allocate the page table, or with a tagged trace, let mm give each
+     process its own. Only the flat table is allocated in full up front; the
+     others grow with the pages that are touched. */
+  if (!pt_chosen && log_size - page_size > DEFAULT_FLAT_BITS)
+    pt_kind = PT_RADIX;
+  if (pt_kind == PT_FLAT && log_size - page_size > PT_FLAT_MAX_BITS)
   {
-    fprintf(stderr, "Unexpected line 2. Abort.\n");
+    fprintf(stderr, "A flat page table for %llu pages is too large. Use -t radix, inverted or hashed.\n",
+            num_pages);
     exit(-1);
   }
-  fgets(line, MAXSTR, stdin);
-  if ((sscanf(line, "Page size: %d^%d", &d, &page_size)) != 2)
+  if (tagged && (policy == POLICY_OPT || pt_kind == PT_INVERTED))
   {
-    fprintf(stderr, "Unexpected line 3. Abort.\n");
+    fprintf(stderr, "A trace of several processes cannot use %s. Abort.\n",
+            policy == POLICY_OPT ? "OPT" : "an inverted page table");
     exit(-1);
   }
-  num_pages = 1 << (log_size - page_size);
-  num_frames = 1 << (phy_size - page_size);
+  page_table = tagged ? NULL : pt_create(pt_kind, pt_levels, log_size - page_size);
 
-  fprintf(stdout, "Number of Pages: %d, Number of Frames: %d\n\n", num_pages, num_frames);
+  /* The TLB is searched before the page table; only a miss walks it */
+  tlb_t *tlb = NULL;
+  if (tlb_entries > 0)
+  {
+    if (tlb_ways == 0)
+      tlb_ways = tlb_entries;
+    if (tlb_ways > tlb_entries || tlb_entries % tlb_ways != 0)
+    {
+      fprintf(stderr, "The TLB entries must be a multiple of its ways. Abort.\n");
+      exit(-1);
+    }
+    tlb = tlb_create((unsigned int)tlb_entries, (unsigned int)tlb_ways, tlb_policy, tlb_tagged);
+  }
 
-  /* Allocate arrays to hold the page table and memory frames map */
-  page_table = (int *)malloc(num_pages * sizeof(int));
-  mem_map = (int *)malloc(num_frames * sizeof(int));
+  /* Frames are handed out lowest first; once they are all in use, the
+     replacement policy picks the page to evict */
+  replacer_t *replacer = replacer_create(policy, (unsigned int)num_frames);
 
-  /* Initialize page table to indicate that no pages are currently mapped to
-     physical memory */
-  memset(page_table, 0, num_pages * sizeof(int));
+  /* A tagged trace runs several processes over the same frames */
+  mm_t *mm = NULL;
+  trace_record_t *records = NULL;
+  unsigned int pid = 0;
+  int write = 0;
+  if (tagged)
+  {
+    mm = mm_create(replacer, tlb, pt_kind, pt_levels, log_size - page_size);
+    records = (trace_record_t *)malloc(BATCH * sizeof(trace_record_t));
+    summary = 1;
+  }
 
-  /* Initialize memory map table to indicate no valid frames */
-  memset(mem_map, 0, num_frames * sizeof(int));
+  /* OPT reads the whole trace first to know when each page is next used */
+  unsigned long long *addrs = NULL, *pages = NULL;
+  long long *next_use = NULL, num_addrs = 0, pos = 0;
+  if (policy == POLICY_OPT)
+  {
+    addrs = read_addresses(trace, &num_addrs);
+    pages = (unsigned long long *)malloc((num_addrs + 1) * sizeof(unsigned long long));
+    next_use = (long long *)malloc((num_addrs + 1) * sizeof(long long));
+    for (pos = 0; pos < num_addrs; pos++)
+      pages[pos] = addrs[pos] >> page_size;
+    replacer_next_uses(pages, num_addrs, next_use);
+    pos = 0;
+  }
 
-  unsigned temp = 0;
-  frame_num = 0;
+  long long accesses = 0, faults = 0, evictions = 0;
+  long long tlb_hits = 0;
+  unsigned long long walk_references = 0;
+  unsigned long long batch[BATCH];
+  long batch_size = 0, batch_pos = 0;
 
   /* Read each accessed address from input file. Map the logical address to
      corresponding physical address */
-  fgets(line, MAXSTR, stdin);
-  while (!(feof(stdin)))
+  for (;;)
   {
-    sscanf(line, "0x%x", &logical_addr);
-    fprintf(stdout, "Logical Address: 0x%x\n", logical_addr);
+    if (addrs != NULL)
+    {
+      if (pos == num_addrs)
+        break;
+      logical_addr = addrs[pos];
+    }
+    else if (mm != NULL)
+    {
+      trace_record_t *record;
+
+      if (batch_pos == batch_size)
+      {
+        batch_size = trace_read_records(trace, records, BATCH);
+        batch_pos = 0;
+        if (batch_size == 0)
+          break;
+      }
+      record = &records[batch_pos++];
+
+      if (record->op == TRACE_FORK)
+      {
+        if (!mm_fork(mm, record->pid, (unsigned int)record->addr))
+          fprintf(stderr, "Process %u forked process %llu, which is running. Ignored.\n", record->pid,
+                  (unsigned long long)record->addr);
+        else if (!quiet)
+          printf("Fork: %u -> %llu\n\n", record->pid, (unsigned long long)record->addr);
+        continue;
+      }
+      if (record->op == TRACE_EXIT)
+      {
+        if (!mm_exit(mm, record->pid))
+          fprintf(stderr, "Process %u exited, but is not running. Ignored.\n", record->pid);
+        else if (!quiet)
+          printf("Exit: %u\n\n", record->pid);
+        continue;
+      }
+      pid = record->pid;
+      write = record->op == TRACE_WRITE;
+      logical_addr = record->addr;
+      if (!quiet)
+        printf("Process: %u\n", pid);
+    }
+    else
+    {
+      if (batch_pos == batch_size)
+      {
+        batch_size = trace_read(trace, batch, BATCH);
+        batch_pos = 0;
+        if (batch_size == 0)
+          break;
+      }
+      logical_addr = batch[batch_pos++];
+    }
+    if (!quiet)
+      fprintf(stdout, "Logical Address: 0x%llx\n", logical_addr);
 
     page_num = logical_addr >> page_size;
-    offset = logical_addr & ((1 << page_size) - 1);
+    offset = logical_addr & ((1ULL << page_size) - 1);
 
-    fprintf(stdout, "Page Number: %d\n", page_num);
+    if (!quiet)
+      fprintf(stdout, "Page Number: %llu\n", page_num);
 
-    if (page_table[page_num] == 0)
+    if (mm != NULL)
     {
-      printf("Page Fault!\n");
-      printf("Frame Number: %d\n", temp);
-      mem_map[temp] = offset;
-      physical_addr = (temp << page_size) | offset;
-      page_table[page_num] = temp + 1;
-      temp++;
+      mm_access_t a;
+
+      mm_access(mm, pid, page_num, write, &a);
+      accesses++;
+      tlb_hits += a.tlb_hit;
+      walk_references += a.walk_references;
+      faults += a.fault;
+      evictions += a.evicted;
+      frame_num = a.frame;
+      if (!quiet)
+      {
+        if (tlb != NULL)
+          printf(a.tlb_hit ? "TLB Hit!\n" : "TLB Miss!\n");
+        if (a.cow)
+          printf("Copy-on-Write!\n");
+        if (a.fault)
+          printf("Page Fault!\n");
+        if (a.evicted)
+          printf("Evicted Page: %llu of process %u\n", a.evicted_page, a.evicted_pid);
+        printf("Frame Number: %u\n", frame_num);
+      }
     }
     else
     {
-      frame_num = page_table[page_num];
-      frame_num--;
-      printf("Frame Number: %d\n", frame_num);
-      physical_addr = (frame_num << page_size) | offset;
+      long long next = next_use != NULL ? next_use[pos] : 0;
+      long long mapped = tlb != NULL ? tlb_lookup(tlb, page_num) : -1;
+      int tlb_hit = mapped >= 0;
+      accesses++;
+
+      if (tlb_hit)
+      {
+        if (!quiet)
+          printf("TLB Hit!\n");
+        tlb_hits++;
+      }
+      else
+      {
+        unsigned long long before = pt_references(page_table);
+
+        if (tlb != NULL && !quiet)
+          printf("TLB Miss!\n");
+        mapped = pt_lookup(page_table, page_num);
+        walk_references += pt_references(page_table) - before;
+      }
+
+      if (mapped < 0)
+      {
+        long long evicted;
+
+        if (!quiet)
+          printf("Page Fault!\n");
+        frame_num = replacer_fault(replacer, page_num, next, &evicted);
+        faults++;
+        if (evicted >= 0)
+        {
+          if (!quiet)
+            printf("Evicted Page: %lld\n", evicted);
+          pt_unmap(page_table, (unsigned long long)evicted);
+          if (tlb != NULL)
+            tlb_invalidate(tlb, 0, (unsigned long long)evicted);
+          evictions++;
+        }
+        if (!quiet)
+          printf("Frame Number: %u\n", frame_num);
+        pt_map(page_table, page_num, frame_num);
+      }
+      else
+      {
+        frame_num = (unsigned int)mapped;
+        replacer_hit(replacer, frame_num, next);
+        if (!quiet)
+          printf("Frame Number: %u\n", frame_num);
+      }
+      if (tlb != NULL && !tlb_hit)
+        tlb_insert(tlb, page_num, frame_num);
     }
+    physical_addr = ((unsigned long long)frame_num << page_size) | offset;
 
-    fprintf(stdout, "Physical Address: 0x%x\n\n", physical_addr);
+    if (!quiet)
+      fprintf(stdout, "Physical Address: 0x%llx\n\n", physical_addr);
 
-    fgets(line, MAXSTR, stdin);
+    pos++;
+  }
+
+  if (summary)
+  {
+    printf("Policy: %s, Frames: %llu\n", policy_name(policy), num_frames);
+    printf("Accesses: %lld, Page Faults: %lld (%lld cold, %lld with eviction), Hits: %lld\n", accesses, faults,
+           faults - evictions, evictions, accesses - faults);
+    printf("Hit Ratio: %.2f%%, Fault Ratio: %.2f%%\n", accesses ? 100.0 * (accesses - faults) / accesses : 0.0,
+           accesses ? 100.0 * faults / accesses : 0.0);
+    unsigned long long pt_memory = mm != NULL ? mm_page_table_bytes(mm) : pt_bytes(page_table);
+    if (pt_kind == PT_RADIX)
+      printf("Page Table: radix, %u levels, %llu bytes%s\n", pt_levels, pt_memory,
+             mm != NULL ? " in all running processes" : "");
+    else
+      printf("Page Table: %s, %llu bytes%s\n", pt_name(pt_kind), pt_memory,
+             mm != NULL ? " in all running processes" : "");
+    if (tlb != NULL)
+    {
+      long long misses = accesses - tlb_hits;
+
+      /* Every access pays for the TLB and the memory reference itself; a
+         miss also pays for the references its walk made */
+      printf("TLB: %lld entries, %lld-way, %s, ASIDs %s\n", tlb_entries, tlb_ways, tlb_policy_name(tlb_policy),
+             tlb_tagged ? "on" : "off");
+      printf("TLB Hits: %lld, TLB Misses: %lld, TLB Hit Ratio: %.2f%%, TLB Flushes: %lld\n", tlb_hits, misses,
+             accesses ? 100.0 * tlb_hits / accesses : 0.0, tlb_flushes(tlb));
+      printf("Effective Access Time: %.2f ns (TLB %g ns, memory %g ns, %.2f references per walk, page faults "
+             "excluded)\n",
+             accesses ? tlb_ns + memory_ns + walk_references * memory_ns / accesses : 0.0, tlb_ns, memory_ns,
+             misses ? (double)walk_references / misses : 0.0);
+    }
+    if (mm != NULL)
+      mm_report(mm, stdout);
   }
 
-  free(page_table);
-  free(mem_map);
+  replacer_destroy(replacer);
+  if (mm != NULL)
+    mm_destroy(mm);
+  else
+    pt_destroy(page_table);
+  free(records);
+  trace_close(trace);
+  if (tlb != NULL)
+    tlb_destroy(tlb);
+  free(addrs);
+  free(pages);
+  free(next_use);
 
   return 0;
 }
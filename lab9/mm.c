@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "mm.h"
+
+typedef struct
+{
+  unsigned int pid;
+  int alive;
+  page_table_t *pt;          /* page -> page object */
+  unsigned long long *pages; /* every page mapped, in the order mapped */
+  unsigned long long num_pages, capacity;
+  long long accesses, faults, cow_faults;
+} process_t;
+
+struct mm
+{
+  replacer_t *replacer;
+  tlb_t *tlb;
+  pt_kind_t kind;
+  unsigned int levels, vpn_bits;
+
+  /* Every process seen, exited ones included; current is the last one
+     looked up */
+  process_t *procs;
+  unsigned int num_procs, procs_capacity, current;
+
+  /* Page objects: the frame holding each (-1 if none), how many pages map
+     it, and the process and page it was created for */
+  int *frame;
+  unsigned int *refs, *creator;
+  unsigned long long *page;
+  unsigned int num_objects, objects_capacity;
+
+  unsigned int resident; /* objects in a frame */
+  long long forks, exits;
+};
+
+/* The replacer and TLB are shared by all processes; the caller still owns
+   them. */
+mm_t *mm_create(replacer_t *replacer, tlb_t *tlb, pt_kind_t kind, unsigned int levels, unsigned int vpn_bits)
+{
+  mm_t *mm = (mm_t *)calloc(1, sizeof(mm_t));
+
+  mm->replacer = replacer;
+  mm->tlb = tlb;
+  mm->kind = kind;
+  mm->levels = levels;
+  mm->vpn_bits = vpn_bits;
+  return mm;
+}
+
+void mm_destroy(mm_t *mm)
+{
+  unsigned int i;
+
+  for (i = 0; i < mm->num_procs; i++)
+  {
+    if (mm->procs[i].alive)
+    {
+      pt_destroy(mm->procs[i].pt);
+      free(mm->procs[i].pages);
+    }
+  }
+  free(mm->procs);
+  free(mm->frame);
+  free(mm->refs);
+  free(mm->creator);
+  free(mm->page);
+  free(mm);
+}
+
+/* Returns the index of the live process pid, or -1. */
+static int find_process(mm_t *mm, unsigned int pid)
+{
+  unsigned int i;
+
+  if (mm->current < mm->num_procs && mm->procs[mm->current].alive && mm->procs[mm->current].pid == pid)
+    return (int)mm->current;
+  for (i = 0; i < mm->num_procs; i++)
+  {
+    if (mm->procs[i].alive && mm->procs[i].pid == pid)
+    {
+      mm->current = i;
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+/* Returns the index of the live process pid, starting it with an empty
+   address space if there is none. */
+static int get_process(mm_t *mm, unsigned int pid)
+{
+  int i = find_process(mm, pid);
+  process_t *p;
+
+  if (i >= 0)
+    return i;
+
+  if (mm->num_procs == mm->procs_capacity)
+  {
+    mm->procs_capacity = mm->procs_capacity > 0 ? 2 * mm->procs_capacity : 16;
+    mm->procs = (process_t *)realloc(mm->procs, mm->procs_capacity * sizeof(process_t));
+  }
+  p = &mm->procs[mm->num_procs];
+  memset(p, 0, sizeof(process_t));
+  p->pid = pid;
+  p->alive = 1;
+  p->pt = pt_create(mm->kind, mm->levels, mm->vpn_bits);
+  mm->current = mm->num_procs;
+  return (int)mm->num_procs++;
+}
+
+static unsigned int new_object(mm_t *mm, unsigned int pid, unsigned long long page)
+{
+  unsigned int obj = mm->num_objects++;
+
+  if (obj == mm->objects_capacity)
+  {
+    mm->objects_capacity = mm->objects_capacity > 0 ? 2 * mm->objects_capacity : 1024;
+    mm->frame = (int *)realloc(mm->frame, mm->objects_capacity * sizeof(int));
+    mm->refs = (unsigned int *)realloc(mm->refs, mm->objects_capacity * sizeof(unsigned int));
+    mm->creator = (unsigned int *)realloc(mm->creator, mm->objects_capacity * sizeof(unsigned int));
+    mm->page = (unsigned long long *)realloc(mm->page, mm->objects_capacity * sizeof(unsigned long long));
+  }
+  mm->frame[obj] = -1;
+  mm->refs[obj] = 1;
+  mm->creator[obj] = pid;
+  mm->page[obj] = page;
+  return obj;
+}
+
+/* Maps a page that p has not mapped before */
+static void map_page(process_t *p, unsigned long long page, unsigned int obj)
+{
+  pt_map(p->pt, page, obj);
+  if (p->num_pages == p->capacity)
+  {
+    p->capacity = p->capacity > 0 ? 2 * p->capacity : 64;
+    p->pages = (unsigned long long *)realloc(p->pages, p->capacity * sizeof(unsigned long long));
+  }
+  p->pages[p->num_pages++] = page;
+}
+
+/* Translates an access by pid to page, starting the process if it is new.
+   A page touched for the first time gets a new, zero-filled object. */
+void mm_access(mm_t *mm, unsigned int pid, unsigned long long page, int write, mm_access_t *result)
+{
+  int i = get_process(mm, pid);
+  process_t *p = &mm->procs[i];
+  long long frame = -1, obj = -1;
+
+  memset(result, 0, sizeof(mm_access_t));
+  p->accesses++;
+
+  if (mm->tlb != NULL)
+  {
+    tlb_switch(mm->tlb, pid);
+    frame = tlb_lookup(mm->tlb, page);
+    result->tlb_hit = frame >= 0;
+  }
+
+  /* A write needs the object even after a TLB hit, to see if it is shared */
+  if (!result->tlb_hit || write)
+  {
+    unsigned long long before = pt_references(p->pt);
+
+    obj = pt_lookup(p->pt, page);
+    if (!result->tlb_hit)
+      result->walk_references = pt_references(p->pt) - before;
+
+    if (obj < 0)
+    {
+      obj = new_object(mm, pid, page);
+      map_page(p, page, (unsigned int)obj);
+    }
+    else if (write && mm->refs[obj] > 1)
+    {
+      mm->refs[obj]--;
+      obj = new_object(mm, pid, page);
+      pt_unmap(p->pt, page);
+      pt_map(p->pt, page, (unsigned int)obj);
+      result->cow = 1;
+      p->cow_faults++;
+    }
+    frame = mm->frame[obj];
+  }
+
+  if (frame < 0)
+  {
+    long long evicted;
+
+    frame = replacer_fault(mm->replacer, (unsigned long long)obj, 0, &evicted);
+    if (evicted >= 0)
+    {
+      mm->frame[evicted] = -1;
+      if (mm->tlb != NULL)
+        tlb_shootdown(mm->tlb, mm->page[evicted], (unsigned int)frame);
+      result->evicted = 1;
+      result->evicted_pid = mm->creator[evicted];
+      result->evicted_page = mm->page[evicted];
+    }
+    else
+      mm->resident++;
+    mm->frame[obj] = (int)frame;
+    result->fault = 1;
+    p->faults++;
+  }
+  else
+    replacer_hit(mm->replacer, (unsigned int)frame, 0);
+
+  if (mm->tlb != NULL && (!result->tlb_hit || result->cow))
+  {
+    tlb_invalidate(mm->tlb, pid, page);
+    tlb_insert(mm->tlb, page, (unsigned int)frame);
+  }
+  result->frame = (unsigned int)frame;
+}
+
+/* Starts child as a copy of parent, sharing all of its objects. Returns 0
+   if child is already running. */
+int mm_fork(mm_t *mm, unsigned int parent, unsigned int child)
+{
+  process_t *p, *c;
+  unsigned long long i;
+  int pi, ci;
+
+  if (find_process(mm, child) >= 0)
+    return 0;
+  pi = get_process(mm, parent);
+  ci = get_process(mm, child);
+  p = &mm->procs[pi];
+  c = &mm->procs[ci];
+
+  for (i = 0; i < p->num_pages; i++)
+  {
+    long long obj = pt_lookup(p->pt, p->pages[i]);
+
+    map_page(c, p->pages[i], (unsigned int)obj);
+    mm->refs[obj]++;
+  }
+  mm->forks++;
+  return 1;
+}
+
+/* Ends pid. Objects no other process maps have their frames freed. Returns
+   0 if pid is not running. */
+int mm_exit(mm_t *mm, unsigned int pid)
+{
+  int i = find_process(mm, pid);
+  process_t *p;
+  unsigned long long j;
+
+  if (i < 0)
+    return 0;
+  p = &mm->procs[i];
+
+  for (j = 0; j < p->num_pages; j++)
+  {
+    long long obj = pt_lookup(p->pt, p->pages[j]);
+
+    if (--mm->refs[obj] == 0 && mm->frame[obj] >= 0)
+    {
+      if (mm->tlb != NULL)
+        tlb_shootdown(mm->tlb, mm->page[obj], (unsigned int)mm->frame[obj]);
+      replacer_release(mm->replacer, (unsigned int)mm->frame[obj]);
+      mm->frame[obj] = -1;
+      mm->resident--;
+    }
+  }
+  if (mm->tlb != NULL)
+    tlb_flush_asid(mm->tlb, pid);
+
+  pt_destroy(p->pt);
+  free(p->pages);
+  p->pt = NULL;
+  p->pages = NULL;
+  p->alive = 0;
+  mm->exits++;
+  return 1;
+}
+
+/* Memory held by the page tables of the processes still running */
+unsigned long long mm_page_table_bytes(const mm_t *mm)
+{
+  unsigned long long bytes = 0;
+  unsigned int i;
+
+  for (i = 0; i < mm->num_procs; i++)
+    if (mm->procs[i].alive)
+      bytes += pt_bytes(mm->procs[i].pt);
+  return bytes;
+}
+
+/* Prints each process's counts and resident set. RSS counts the resident
+   pages a process maps; PSS splits each of them evenly between the
+   processes that map it, so the PSS of all processes adds up to the frames
+   in use. */
+void mm_report(mm_t *mm, FILE *out)
+{
+  unsigned long long total_rss = 0;
+  unsigned int i;
+
+  for (i = 0; i < mm->num_procs; i++)
+  {
+    process_t *p = &mm->procs[i];
+    unsigned long long rss = 0, shared = 0, j;
+    double pss = 0;
+
+    fprintf(out, "Process %u: Accesses: %lld, Page Faults: %lld, Copy-on-Write: %lld, ", p->pid, p->accesses, p->faults,
+            p->cow_faults);
+    if (!p->alive)
+    {
+      fprintf(out, "exited\n");
+      continue;
+    }
+
+    for (j = 0; j < p->num_pages; j++)
+    {
+      long long obj = pt_lookup(p->pt, p->pages[j]);
+
+      if (mm->frame[obj] >= 0)
+      {
+        rss++;
+        pss += 1.0 / mm->refs[obj];
+        shared += mm->refs[obj] > 1;
+      }
+    }
+    total_rss += rss;
+    fprintf(out, "RSS: %llu pages (%llu shared), PSS: %.1f pages\n", rss, shared, pss);
+  }
+
+  fprintf(out, "Processes: %u (%lld exited), Forks: %lld, Frames in Use: %u, Total RSS: %llu pages (%.2f per frame)\n",
+          mm->num_procs, mm->exits, mm->forks, mm->resident, total_rss,
+          mm->resident ? (double)total_rss / mm->resident : 0.0);
+}
@@ -0,0 +1,41 @@
+#ifndef MM_H
+#define MM_H
+
+#include <stdio.h>
+
+#include "replace.h"
+#include "pagetable.h"
+#include "tlb.h"
+
+/* Several processes sharing one pool of frames. Each process has its own
+   page table, which maps its pages to page objects; an object is a page of
+   memory that may be mapped by several processes at once, and is either
+   resident in a frame or not. The replacer works on objects, so a shared
+   page takes one frame and is evicted from every process at once.
+
+   A fork maps all of the parent's objects into the child as well. A write
+   to an object that more than one page maps copies it first (copy on
+   write), and an exit frees the frames of objects no one maps any more. */
+typedef struct mm mm_t;
+
+/* What one access did */
+typedef struct
+{
+  unsigned int frame;
+  int tlb_hit, fault, cow;
+  int evicted;                      /* whether a page was evicted */
+  unsigned int evicted_pid;         /* the process that created it */
+  unsigned long long evicted_page;
+  unsigned long long walk_references; /* made by the page table walk */
+} mm_access_t;
+
+mm_t *mm_create(replacer_t *replacer, tlb_t *tlb, pt_kind_t kind, unsigned int levels, unsigned int vpn_bits);
+void  mm_destroy(mm_t *mm);
+void  mm_access(mm_t *mm, unsigned int pid, unsigned long long page, int write, mm_access_t *result);
+int   mm_fork(mm_t *mm, unsigned int parent, unsigned int child);
+int   mm_exit(mm_t *mm, unsigned int pid);
+
+unsigned long long mm_page_table_bytes(const mm_t *mm);
+void               mm_report(mm_t *mm, FILE *out);
+
+#endif
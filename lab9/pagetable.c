@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pagetable.h"
+
+#define NONE (-1)
+#define MAX_LEVELS 4
+
+/* An entry of the inverted or hashed table. The inverted table keeps entry
+   i for frame i; the hashed table takes entries from a pool as pages are
+   mapped and keeps unused ones on a free list. */
+typedef struct
+{
+  unsigned long long vpn;
+  unsigned int frame;
+  int next; /* next entry in the bucket, or on the free list */
+  int used;
+} pt_entry_t;
+
+struct page_table
+{
+  pt_kind_t kind;
+  unsigned long long bytes;
+  unsigned long long references; /* memory references made reading the table */
+
+  /* FLAT: frame + 1 per page, 0 when the page is not mapped */
+  unsigned int *flat;
+
+  /* RADIX: level 0 is the root. Interior nodes hold child pointers and
+     leaves hold frame + 1 per page, like the flat table. */
+  unsigned int levels;
+  unsigned int shift[MAX_LEVELS], bits[MAX_LEVELS];
+  void *root;
+
+  /* INVERTED and HASHED */
+  pt_entry_t *entries;
+  int capacity, free_list;
+  int *buckets;
+  unsigned int bucket_mask, count;
+};
+
+static const char *pt_names[] = {"flat", "radix", "inverted", "hashed"};
+
+/* Looks a page table kind up by name, ignoring case. "radix2" to "radix4"
+   also set the number of levels; plain "radix" leaves it alone. Returns 0
+   if the name is unknown. */
+int pt_parse(const char *name, pt_kind_t *kind, unsigned int *levels)
+{
+  int i;
+
+  for (i = 0; i <= PT_HASHED; i++)
+  {
+    if (strcasecmp(name, pt_names[i]) == 0)
+    {
+      *kind = (pt_kind_t)i;
+      return 1;
+    }
+  }
+  if (strncasecmp(name, "radix", 5) == 0 && name[5] >= '2' && name[5] <= '0' + MAX_LEVELS && name[6] == '\0')
+  {
+    *kind = PT_RADIX;
+    *levels = name[5] - '0';
+    return 1;
+  }
+  return 0;
+}
+
+const char *pt_name(pt_kind_t kind)
+{
+  return pt_names[kind];
+}
+
+static void *pt_calloc(page_table_t *pt, size_t count, size_t size)
+{
+  pt->bytes += count * size;
+  return calloc(count, size);
+}
+
+/* Creates an empty table for page numbers of vpn_bits bits. levels is only
+   used by RADIX. Returns NULL if FLAT is asked for a space too large to
+   allocate. */
+page_table_t *pt_create(pt_kind_t kind, unsigned int levels, unsigned int vpn_bits)
+{
+  page_table_t *pt;
+  unsigned int i, shift;
+
+  if (kind == PT_FLAT && vpn_bits > PT_FLAT_MAX_BITS)
+    return NULL;
+
+  pt = (page_table_t *)calloc(1, sizeof(page_table_t));
+  pt->kind = kind;
+  pt->free_list = NONE;
+
+  switch (kind)
+  {
+  case PT_FLAT:
+    pt->flat = (unsigned int *)pt_calloc(pt, (size_t)1 << vpn_bits, sizeof(unsigned int));
+    break;
+
+  case PT_RADIX:
+    /* Split the page number evenly; the upper levels take any bits left
+       over, so the leaves stay small */
+    pt->levels = levels < 2 ? 2 : levels > MAX_LEVELS ? MAX_LEVELS : levels;
+    shift = vpn_bits;
+    for (i = 0; i < pt->levels; i++)
+    {
+      pt->bits[i] = vpn_bits / pt->levels + (i < vpn_bits % pt->levels);
+      shift -= pt->bits[i];
+      pt->shift[i] = shift;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return pt;
+}
+
+static void radix_free(page_table_t *pt, void *node, unsigned int level)
+{
+  unsigned long long i;
+
+  if (node == NULL)
+    return;
+  if (level + 1 < pt->levels)
+    for (i = 0; i < 1ULL << pt->bits[level]; i++)
+      radix_free(pt, ((void **)node)[i], level + 1);
+  free(node);
+}
+
+void pt_destroy(page_table_t *pt)
+{
+  radix_free(pt, pt->root, 0);
+  free(pt->flat);
+  free(pt->entries);
+  free(pt->buckets);
+  free(pt);
+}
+
+/* Returns the leaf slot for vpn. With create, missing nodes on the way are
+   allocated; without it, NULL is returned if there is none, and each node
+   read counts as a memory reference. */
+static unsigned int *radix_slot(page_table_t *pt, unsigned long long vpn, int create)
+{
+  void **node = &pt->root;
+  unsigned int level;
+
+  for (level = 0;; level++)
+  {
+    unsigned long long index = (vpn >> pt->shift[level]) & ((1ULL << pt->bits[level]) - 1);
+    int leaf = level + 1 == pt->levels;
+
+    if (*node == NULL)
+    {
+      if (!create)
+        return NULL;
+      *node = pt_calloc(pt, (size_t)1 << pt->bits[level], leaf ? sizeof(unsigned int) : sizeof(void *));
+    }
+    if (!create)
+      pt->references++;
+    if (leaf)
+      return (unsigned int *)*node + index;
+    node = (void **)*node + index;
+  }
+}
+
+static unsigned int hash_vpn(const page_table_t *pt, unsigned long long vpn)
+{
+  vpn *= 0x9e3779b97f4a7c15ULL;
+  return (unsigned int)(vpn ^ (vpn >> 29)) & pt->bucket_mask;
+}
+
+/* Makes room for entry ids below needed; new entries are unused. */
+static void reserve_entries(page_table_t *pt, int needed)
+{
+  int old = pt->capacity, capacity = old > 0 ? old : 64;
+
+  if (needed <= old)
+    return;
+  while (capacity < needed)
+    capacity *= 2;
+  pt->entries = (pt_entry_t *)realloc(pt->entries, capacity * sizeof(pt_entry_t));
+  memset(pt->entries + old, 0, (capacity - old) * sizeof(pt_entry_t));
+  pt->bytes += (capacity - old) * sizeof(pt_entry_t);
+  pt->capacity = capacity;
+}
+
+/* Keeps the anchor table at least as large as the number of pages mapped,
+   doubling it and rehashing when it falls behind. */
+static void grow_buckets(page_table_t *pt)
+{
+  unsigned int old = pt->buckets != NULL ? pt->bucket_mask + 1 : 0, size = old > 0 ? 2 * old : 64;
+  int i;
+
+  if (pt->count < old)
+    return;
+  free(pt->buckets);
+  pt->bytes += (size - old) * sizeof(int);
+  pt->buckets = (int *)malloc(size * sizeof(int));
+  pt->bucket_mask = size - 1;
+  for (i = 0; i < (int)size; i++)
+    pt->buckets[i] = NONE;
+  for (i = 0; i < pt->capacity; i++)
+  {
+    if (pt->entries[i].used)
+    {
+      unsigned int h = hash_vpn(pt, pt->entries[i].vpn);
+
+      pt->entries[i].next = pt->buckets[h];
+      pt->buckets[h] = i;
+    }
+  }
+}
+
+/* Returns the entry holding vpn, or NONE. With prev, also returns the entry
+   before it in its bucket (NONE if it is first). The anchor and each entry
+   read count as memory references. */
+static int hash_find(page_table_t *pt, unsigned long long vpn, int *prev)
+{
+  int e, before = NONE;
+
+  if (pt->buckets == NULL)
+    return NONE;
+  pt->references++;
+  for (e = pt->buckets[hash_vpn(pt, vpn)]; e != NONE; before = e, e = pt->entries[e].next)
+  {
+    pt->references++;
+    if (pt->entries[e].vpn == vpn)
+    {
+      if (prev != NULL)
+        *prev = before;
+      return e;
+    }
+  }
+  return NONE;
+}
+
+/* Returns the frame vpn is mapped to, or -1 if it is not mapped. */
+long long pt_lookup(page_table_t *pt, unsigned long long vpn)
+{
+  unsigned int *slot;
+  int e;
+
+  switch (pt->kind)
+  {
+  case PT_FLAT:
+    pt->references++;
+    return (long long)pt->flat[vpn] - 1;
+  case PT_RADIX:
+    slot = radix_slot(pt, vpn, 0);
+    return slot != NULL ? (long long)*slot - 1 : -1;
+  default:
+    e = hash_find(pt, vpn, NULL);
+    return e != NONE ? (long long)pt->entries[e].frame : -1;
+  }
+}
+
+/* Maps vpn to frame. The page must not be mapped already, and for INVERTED
+   the frame must not hold another page. */
+void pt_map(page_table_t *pt, unsigned long long vpn, unsigned int frame)
+{
+  unsigned int h;
+  int e;
+
+  switch (pt->kind)
+  {
+  case PT_FLAT:
+    pt->flat[vpn] = frame + 1;
+    return;
+  case PT_RADIX:
+    *radix_slot(pt, vpn, 1) = frame + 1;
+    return;
+  case PT_INVERTED:
+    e = (int)frame;
+    reserve_entries(pt, e + 1);
+    break;
+  default:
+    if (pt->free_list == NONE)
+    {
+      reserve_entries(pt, (int)pt->count + 1);
+      e = (int)pt->count;
+    }
+    else
+    {
+      e = pt->free_list;
+      pt->free_list = pt->entries[e].next;
+    }
+    break;
+  }
+
+  pt->count++;
+  grow_buckets(pt);
+  h = hash_vpn(pt, vpn);
+  pt->entries[e].vpn = vpn;
+  pt->entries[e].frame = frame;
+  pt->entries[e].used = 1;
+  pt->entries[e].next = pt->buckets[h];
+  pt->buckets[h] = e;
+}
+
+/* Removes the mapping of vpn, if there is one. Radix nodes are kept. */
+void pt_unmap(page_table_t *pt, unsigned long long vpn)
+{
+  unsigned int *slot;
+  int e, prev;
+
+  switch (pt->kind)
+  {
+  case PT_FLAT:
+    pt->flat[vpn] = 0;
+    return;
+  case PT_RADIX:
+    slot = radix_slot(pt, vpn, 0);
+    if (slot != NULL)
+      *slot = 0;
+    return;
+  default:
+    e = hash_find(pt, vpn, &prev);
+    if (e == NONE)
+      return;
+    if (prev == NONE)
+      pt->buckets[hash_vpn(pt, vpn)] = pt->entries[e].next;
+    else
+      pt->entries[prev].next = pt->entries[e].next;
+    pt->entries[e].used = 0;
+    if (pt->kind == PT_HASHED)
+    {
+      pt->entries[e].next = pt->free_list;
+      pt->free_list = e;
+    }
+    pt->count--;
+    return;
+  }
+}
+
+/* Memory references made reading the table so far. The difference across
+   a pt_lookup is the cost of that walk. */
+unsigned long long pt_references(const page_table_t *pt)
+{
+  return pt->references;
+}
+
+/* Memory the table has allocated for its entries and nodes. */
+unsigned long long pt_bytes(const page_table_t *pt)
+{
+  return pt->bytes;
+}
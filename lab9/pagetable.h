@@ -0,0 +1,40 @@
+#ifndef PAGETABLE_H
+#define PAGETABLE_H
+
+/* Ways to map virtual page numbers to frames. FLAT is one entry per page
+   of the logical address space, allocated up front, which is only possible
+   for small spaces. The others allocate as pages are mapped, so their
+   memory follows the pages actually touched:
+
+   RADIX    a tree of 2 to 4 levels, each indexed by a slice of the page
+            number; a node is allocated the first time a page under it is
+            mapped, and kept after that
+   INVERTED one entry per frame in use, holding the page in it, found
+            through a hash anchor table
+   HASHED   a chained hash table of page -> frame entries */
+typedef enum
+{
+  PT_FLAT = 0,
+  PT_RADIX,
+  PT_INVERTED,
+  PT_HASHED
+} pt_kind_t;
+
+/* largest page number width FLAT accepts */
+#define PT_FLAT_MAX_BITS 30
+
+typedef struct page_table page_table_t;
+
+int           pt_parse(const char *name, pt_kind_t *kind, unsigned int *levels);
+const char   *pt_name(pt_kind_t kind);
+
+page_table_t *pt_create(pt_kind_t kind, unsigned int levels, unsigned int vpn_bits);
+void          pt_destroy(page_table_t *pt);
+long long     pt_lookup(page_table_t *pt, unsigned long long vpn);
+void          pt_map(page_table_t *pt, unsigned long long vpn, unsigned int frame);
+void          pt_unmap(page_table_t *pt, unsigned long long vpn);
+
+unsigned long long pt_references(const page_table_t *pt);
+unsigned long long pt_bytes(const page_table_t *pt);
+
+#endif
@@ -0,0 +1,532 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+
+#include "replace.h"
+
+/* Every policy keeps its bookkeeping in nodes. Nodes 0 .. num_frames-1 are
+   the frames themselves; ARC also has num_frames ghost nodes after them,
+   which remember pages that were recently evicted. A node is on at most
+   one doubly linked list at a time.
+
+   Frames are handed out lowest first, so the node arrays only grow as far
+   as the frames in use, and ARC adds its ghosts once memory is full. A
+   huge physical memory costs nothing until it is touched. Released frames
+   wait on LIST_FREE and are handed out again before anything is evicted. */
+#define NONE (-1)
+
+enum { LIST_QUEUE = 0, LIST_T1 = 0, LIST_T2, LIST_B1, LIST_B2, LIST_GHOST_FREE, LIST_FREE, NUM_LISTS };
+
+typedef struct
+{
+  int head, tail;
+  unsigned int size;
+} list_t;
+
+struct replacer
+{
+  policy_t policy;
+  unsigned int num_frames, used_frames;
+  unsigned int capacity; /* nodes the arrays below have room for */
+
+  unsigned long long *page; /* node -> page it holds */
+  int *prev, *next;    /* list links */
+  unsigned char *list; /* node -> list it is on */
+  list_t lists[NUM_LISTS];
+
+  /* CLOCK and second chance */
+  unsigned char *referenced;
+  unsigned int hand;
+
+  /* ARC: target size of T1, and a hash from page to ghost node */
+  double target;
+  int *buckets, *chain;
+  unsigned int bucket_mask;
+
+  /* OPT: max-heap of frames by next use */
+  long long *next_use;
+  int *heap, *heap_pos;
+};
+
+static const char *policy_names[] = {"FIFO", "LRU", "CLOCK", "SECOND-CHANCE", "ARC", "OPT"};
+
+/* Looks a policy up by name, ignoring case. "belady" is accepted for OPT
+   and "sc" for second chance. Returns 0 if the name is unknown. */
+int policy_parse(const char *name, policy_t *policy)
+{
+  int i;
+
+  for (i = 0; i <= POLICY_OPT; i++)
+  {
+    if (strcasecmp(name, policy_names[i]) == 0)
+    {
+      *policy = (policy_t)i;
+      return 1;
+    }
+  }
+  if (strcasecmp(name, "belady") == 0)
+  {
+    *policy = POLICY_OPT;
+    return 1;
+  }
+  if (strcasecmp(name, "sc") == 0)
+  {
+    *policy = POLICY_SECOND_CHANCE;
+    return 1;
+  }
+  return 0;
+}
+
+const char *policy_name(policy_t policy)
+{
+  return policy_names[policy];
+}
+
+static void list_push_tail(replacer_t *r, int l, int node)
+{
+  list_t *list = &r->lists[l];
+
+  r->prev[node] = list->tail;
+  r->next[node] = NONE;
+  if (list->tail != NONE)
+    r->next[list->tail] = node;
+  else
+    list->head = node;
+  list->tail = node;
+  list->size++;
+  r->list[node] = l;
+}
+
+static void list_remove(replacer_t *r, int node)
+{
+  list_t *list = &r->lists[r->list[node]];
+
+  if (r->prev[node] != NONE)
+    r->next[r->prev[node]] = r->next[node];
+  else
+    list->head = r->next[node];
+  if (r->next[node] != NONE)
+    r->prev[r->next[node]] = r->prev[node];
+  else
+    list->tail = r->prev[node];
+  list->size--;
+}
+
+static int list_pop_head(replacer_t *r, int l)
+{
+  int node = r->lists[l].head;
+
+  list_remove(r, node);
+  return node;
+}
+
+/* ARC ghost directory */
+
+static unsigned long long mix(unsigned long long page)
+{
+  page *= 0x9e3779b97f4a7c15ULL;
+  return page ^ (page >> 29);
+}
+
+static unsigned int hash_page(const replacer_t *r, unsigned long long page)
+{
+  return (unsigned int)mix(page) & r->bucket_mask;
+}
+
+static int ghost_find(replacer_t *r, unsigned long long page)
+{
+  int node;
+
+  if (r->buckets == NULL)
+    return NONE;
+  for (node = r->buckets[hash_page(r, page)]; node != NONE; node = r->chain[node - r->num_frames])
+    if (r->page[node] == page)
+      return node;
+  return NONE;
+}
+
+/* Turns the page held by frame into a ghost on list l. */
+static void ghost_add(replacer_t *r, int l, unsigned long long page)
+{
+  int node = list_pop_head(r, LIST_GHOST_FREE);
+  unsigned int b = hash_page(r, page);
+
+  r->page[node] = page;
+  r->chain[node - r->num_frames] = r->buckets[b];
+  r->buckets[b] = node;
+  list_push_tail(r, l, node);
+}
+
+static void ghost_drop(replacer_t *r, int node)
+{
+  int *link = &r->buckets[hash_page(r, r->page[node])];
+
+  while (*link != node)
+    link = &r->chain[*link - r->num_frames];
+  *link = r->chain[node - r->num_frames];
+
+  list_remove(r, node);
+  list_push_tail(r, LIST_GHOST_FREE, node);
+}
+
+/* OPT heap. A page that is never used again sorts above everything. */
+
+static long long heap_key(const replacer_t *r, int frame)
+{
+  return r->next_use[frame] == NEVER_USED_AGAIN ? LLONG_MAX : r->next_use[frame];
+}
+
+static void heap_swap(replacer_t *r, int i, int j)
+{
+  int a = r->heap[i], b = r->heap[j];
+
+  r->heap[i] = b;
+  r->heap[j] = a;
+  r->heap_pos[b] = i;
+  r->heap_pos[a] = j;
+}
+
+static void heap_fix(replacer_t *r, int i)
+{
+  int size = (int)r->used_frames;
+
+  while (i > 0 && heap_key(r, r->heap[i]) > heap_key(r, r->heap[(i - 1) / 2]))
+  {
+    heap_swap(r, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+  for (;;)
+  {
+    int largest = i, child;
+
+    for (child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++)
+      if (heap_key(r, r->heap[child]) > heap_key(r, r->heap[largest]))
+        largest = child;
+    if (largest == i)
+      break;
+    heap_swap(r, i, largest);
+    i = largest;
+  }
+}
+
+/* Makes room for node ids below needed. */
+static void reserve_nodes(replacer_t *r, unsigned int needed)
+{
+  unsigned int old = r->capacity, capacity = old > 0 ? old : 64;
+
+  if (needed <= old)
+    return;
+  while (capacity < needed)
+    capacity *= 2;
+
+  r->page = (unsigned long long *)realloc(r->page, capacity * sizeof(unsigned long long));
+  r->prev = (int *)realloc(r->prev, capacity * sizeof(int));
+  r->next = (int *)realloc(r->next, capacity * sizeof(int));
+  r->list = (unsigned char *)realloc(r->list, capacity);
+
+  if (r->policy == POLICY_CLOCK || r->policy == POLICY_SECOND_CHANCE)
+  {
+    r->referenced = (unsigned char *)realloc(r->referenced, capacity);
+    memset(r->referenced + old, 0, capacity - old);
+  }
+
+  if (r->policy == POLICY_OPT)
+  {
+    r->next_use = (long long *)realloc(r->next_use, capacity * sizeof(long long));
+    r->heap = (int *)realloc(r->heap, capacity * sizeof(int));
+    r->heap_pos = (int *)realloc(r->heap_pos, capacity * sizeof(int));
+  }
+
+  r->capacity = capacity;
+}
+
+/* Gives ARC its ghost nodes, once every frame is in use. */
+static void arc_add_ghosts(replacer_t *r)
+{
+  unsigned int i, c = r->num_frames;
+
+  reserve_nodes(r, 2 * c);
+  for (r->bucket_mask = 1; r->bucket_mask < 2 * c; r->bucket_mask <<= 1)
+    ;
+  r->buckets = (int *)malloc(r->bucket_mask * sizeof(int));
+  r->chain = (int *)malloc(c * sizeof(int));
+  for (i = 0; i < r->bucket_mask; i++)
+    r->buckets[i] = NONE;
+  r->bucket_mask--;
+  for (i = c; i < 2 * c; i++)
+    list_push_tail(r, LIST_GHOST_FREE, i);
+}
+
+/* Creates the replacement state for num_frames empty frames. Nothing is
+   allocated per frame until the frame is used. */
+replacer_t *replacer_create(policy_t policy, unsigned int num_frames)
+{
+  replacer_t *r = (replacer_t *)calloc(1, sizeof(replacer_t));
+  unsigned int i;
+
+  r->policy = policy;
+  r->num_frames = num_frames;
+  for (i = 0; i < NUM_LISTS; i++)
+  {
+    r->lists[i].head = r->lists[i].tail = NONE;
+    r->lists[i].size = 0;
+  }
+
+  return r;
+}
+
+/* Whether a frame can be had without evicting anything */
+static int has_free_frame(const replacer_t *r)
+{
+  return r->used_frames < r->num_frames || r->lists[LIST_FREE].size > 0;
+}
+
+/* Hands out a released frame, or else the lowest one never used. CLOCK and
+   OPT keep released frames where they were, under the hand and in the heap,
+   which is harmless: nothing is evicted while a frame is free. */
+static int take_free_frame(replacer_t *r)
+{
+  int frame;
+
+  if (r->lists[LIST_FREE].size > 0)
+    return list_pop_head(r, LIST_FREE);
+
+  reserve_nodes(r, r->used_frames + 1);
+  frame = (int)r->used_frames++;
+  if (r->policy == POLICY_OPT)
+  {
+    r->heap[frame] = frame;
+    r->heap_pos[frame] = frame;
+  }
+  return frame;
+}
+
+/* Frees frame, whose page is gone for good (its process exited), for the
+   next fault. The page is not remembered as an ARC ghost. */
+void replacer_release(replacer_t *r, unsigned int frame)
+{
+  if (r->policy != POLICY_CLOCK && r->policy != POLICY_OPT)
+    list_remove(r, (int)frame);
+  list_push_tail(r, LIST_FREE, (int)frame);
+}
+
+void replacer_destroy(replacer_t *r)
+{
+  free(r->page);
+  free(r->prev);
+  free(r->next);
+  free(r->list);
+  free(r->referenced);
+  free(r->buckets);
+  free(r->chain);
+  free(r->next_use);
+  free(r->heap);
+  free(r->heap_pos);
+  free(r);
+}
+
+/* Notes a reference to a page that is resident in frame. next_use is the
+   position in the trace of the page's next reference (OPT only). */
+void replacer_hit(replacer_t *r, unsigned int frame, long long next_use)
+{
+  switch (r->policy)
+  {
+  case POLICY_LRU:
+    list_remove(r, frame);
+    list_push_tail(r, LIST_QUEUE, frame);
+    break;
+  case POLICY_CLOCK:
+  case POLICY_SECOND_CHANCE:
+    r->referenced[frame] = 1;
+    break;
+  case POLICY_ARC:
+    list_remove(r, frame);
+    list_push_tail(r, LIST_T2, frame);
+    break;
+  case POLICY_OPT:
+    r->next_use[frame] = next_use;
+    heap_fix(r, r->heap_pos[frame]);
+    break;
+  default:
+    break;
+  }
+}
+
+/* ARC's REPLACE: evicts the LRU page of T1 or T2, depending on how T1
+   compares with its target size, and remembers it as a ghost. */
+static int arc_replace(replacer_t *r, int hit_in_b2)
+{
+  unsigned int t1 = r->lists[LIST_T1].size;
+  int frame;
+
+  if (t1 >= 1 && ((hit_in_b2 && t1 == (unsigned int)r->target) || t1 > r->target))
+  {
+    frame = list_pop_head(r, LIST_T1);
+    ghost_add(r, LIST_B1, r->page[frame]);
+  }
+  else
+  {
+    frame = list_pop_head(r, LIST_T2);
+    ghost_add(r, LIST_B2, r->page[frame]);
+  }
+  return frame;
+}
+
+/* Returns the frame for page and sets *evicted if a page had to go. */
+static int arc_fault(replacer_t *r, unsigned long long page, int *evicted)
+{
+  unsigned int c = r->num_frames;
+  unsigned int t1 = r->lists[LIST_T1].size, t2 = r->lists[LIST_T2].size;
+  unsigned int b1 = r->lists[LIST_B1].size, b2 = r->lists[LIST_B2].size;
+  int full = !has_free_frame(r), ghost, frame;
+
+  *evicted = full;
+  if (full && r->buckets == NULL)
+    arc_add_ghosts(r);
+  ghost = ghost_find(r, page);
+
+  if (ghost != NONE)
+  {
+    /* A ghost hit means the list it came from was too short */
+    int in_b2 = r->list[ghost] == LIST_B2;
+    double delta;
+
+    if (in_b2)
+    {
+      delta = b1 >= b2 ? (double)b1 / b2 : 1;
+      r->target = r->target - delta < 0 ? 0 : r->target - delta;
+    }
+    else
+    {
+      delta = b2 >= b1 ? (double)b2 / b1 : 1;
+      r->target = r->target + delta > c ? c : r->target + delta;
+    }
+    ghost_drop(r, ghost);
+    frame = full ? arc_replace(r, in_b2) : take_free_frame(r);
+    list_push_tail(r, LIST_T2, frame);
+    return frame;
+  }
+
+  if (t1 + b1 == c)
+  {
+    if (t1 < c)
+    {
+      ghost_drop(r, r->lists[LIST_B1].head);
+      frame = full ? arc_replace(r, 0) : take_free_frame(r);
+    }
+    else
+      frame = list_pop_head(r, LIST_T1);
+  }
+  else if (full)
+  {
+    if (t1 + t2 + b1 + b2 == 2 * c)
+      ghost_drop(r, r->lists[LIST_B2].head);
+    frame = arc_replace(r, 0);
+  }
+  else
+    frame = take_free_frame(r);
+
+  list_push_tail(r, LIST_T1, frame);
+  return frame;
+}
+
+/* Finds a frame for a page that is not resident. Free frames are handed out
+   lowest first; once there are none, the policy picks a victim and its page
+   is stored in *evicted_page (-1 if nothing was evicted). Returns the
+   frame. */
+unsigned int replacer_fault(replacer_t *r, unsigned long long page, long long next_use, long long *evicted_page)
+{
+  int frame;
+
+  *evicted_page = -1;
+
+  if (r->policy == POLICY_ARC)
+  {
+    int evicted;
+
+    frame = arc_fault(r, page, &evicted);
+    if (evicted)
+      *evicted_page = (long long)r->page[frame];
+    r->page[frame] = page;
+    return (unsigned int)frame;
+  }
+
+  if (has_free_frame(r))
+    frame = take_free_frame(r);
+  else
+  {
+    switch (r->policy)
+    {
+    case POLICY_CLOCK:
+      while (r->referenced[r->hand])
+      {
+        r->referenced[r->hand] = 0;
+        r->hand = (r->hand + 1) % r->num_frames;
+      }
+      frame = (int)r->hand;
+      r->hand = (r->hand + 1) % r->num_frames;
+      break;
+    case POLICY_SECOND_CHANCE:
+      while (r->referenced[r->lists[LIST_QUEUE].head])
+      {
+        frame = list_pop_head(r, LIST_QUEUE);
+        r->referenced[frame] = 0;
+        list_push_tail(r, LIST_QUEUE, frame);
+      }
+      frame = list_pop_head(r, LIST_QUEUE);
+      break;
+    case POLICY_OPT:
+      frame = r->heap[0];
+      break;
+    default: /* FIFO and LRU: the head of the queue */
+      frame = list_pop_head(r, LIST_QUEUE);
+      break;
+    }
+    *evicted_page = (long long)r->page[frame];
+  }
+
+  r->page[frame] = page;
+  if (r->policy == POLICY_FIFO || r->policy == POLICY_LRU || r->policy == POLICY_SECOND_CHANCE)
+    list_push_tail(r, LIST_QUEUE, frame);
+  if (r->policy == POLICY_CLOCK || r->policy == POLICY_SECOND_CHANCE)
+    r->referenced[frame] = 1;
+  if (r->policy == POLICY_OPT)
+  {
+    r->next_use[frame] = next_use;
+    heap_fix(r, r->heap_pos[frame]);
+  }
+
+  return (unsigned int)frame;
+}
+
+/* For OPT: fills next_use[i] with the position of the next reference to
+   pages[i] after i, or NEVER_USED_AGAIN. One pass from the end with a hash
+   table of the last position seen for each page. */
+void replacer_next_uses(const unsigned long long *pages, long long count, long long *next_use)
+{
+  unsigned long long capacity = 16, mask, h;
+  long long i;
+
+  while (capacity < 2 * (unsigned long long)count)
+    capacity <<= 1;
+  mask = capacity - 1;
+
+  /* Slots hold page + 1 so that 0 marks an empty one */
+  unsigned long long *keys = (unsigned long long *)calloc(capacity, sizeof(unsigned long long));
+  long long *last = (long long *)malloc(capacity * sizeof(long long));
+
+  for (i = count - 1; i >= 0; i--)
+  {
+    unsigned long long key = pages[i] + 1;
+
+    for (h = mix(pages[i]) & mask; keys[h] != 0 && keys[h] != key; h = (h + 1) & mask)
+      ;
+    next_use[i] = keys[h] == 0 ? NEVER_USED_AGAIN : last[h];
+    keys[h] = key;
+    last[h] = i;
+  }
+
+  free(keys);
+  free(last);
+}
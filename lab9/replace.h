@@ -0,0 +1,35 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+/* Page replacement policies. CLOCK and SECOND_CHANCE pick the same
+   victims; CLOCK sweeps a hand over the frames where second chance moves
+   referenced pages to the back of a FIFO queue. OPT is Belady's optimal
+   policy: it evicts the page whose next use is furthest away, so it needs
+   the whole trace up front. */
+typedef enum
+{
+  POLICY_FIFO = 0,
+  POLICY_LRU,
+  POLICY_CLOCK,
+  POLICY_SECOND_CHANCE,
+  POLICY_ARC,
+  POLICY_OPT
+} policy_t;
+
+/* next_use value of a page that is never used again */
+#define NEVER_USED_AGAIN (-1LL)
+
+typedef struct replacer replacer_t;
+
+int         policy_parse(const char *name, policy_t *policy);
+const char *policy_name(policy_t policy);
+
+replacer_t *replacer_create(policy_t policy, unsigned int num_frames);
+void        replacer_destroy(replacer_t *r);
+void        replacer_hit(replacer_t *r, unsigned int frame, long long next_use);
+unsigned    replacer_fault(replacer_t *r, unsigned long long page, long long next_use, long long *evicted_page);
+void        replacer_release(replacer_t *r, unsigned int frame);
+
+void        replacer_next_uses(const unsigned long long *pages, long long count, long long *next_use);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include <strings.h>
+
+#include "tlb.h"
+
+typedef struct
+{
+  unsigned long long page;
+  unsigned long long last_use; /* tlb->clock at the last hit or insert */
+  unsigned int frame, asid;
+  int valid;
+} tlb_entry_t;
+
+struct tlb
+{
+  unsigned int num_sets, ways;
+  tlb_policy_t policy;
+  int tagged;
+  unsigned int asid; /* current address space */
+
+  unsigned long long clock, random;
+  long long flushes;
+
+  tlb_entry_t *entries; /* set s is entries[s * ways .. s * ways + ways - 1] */
+};
+
+static const char *tlb_policy_names[] = {"LRU", "RANDOM"};
+
+/* Looks a TLB replacement policy up by name, ignoring case. Returns 0 if
+   the name is unknown. */
+int tlb_parse_policy(const char *name, tlb_policy_t *policy)
+{
+  int i;
+
+  for (i = 0; i <= TLB_RANDOM; i++)
+  {
+    if (strcasecmp(name, tlb_policy_names[i]) == 0)
+    {
+      *policy = (tlb_policy_t)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+const char *tlb_policy_name(tlb_policy_t policy)
+{
+  return tlb_policy_names[policy];
+}
+
+/* Creates an empty TLB. entries must be a multiple of ways. */
+tlb_t *tlb_create(unsigned int entries, unsigned int ways, tlb_policy_t policy, int tagged)
+{
+  tlb_t *tlb = (tlb_t *)calloc(1, sizeof(tlb_t));
+
+  tlb->num_sets = entries / ways;
+  tlb->ways = ways;
+  tlb->policy = policy;
+  tlb->tagged = tagged;
+  tlb->random = 0x2545f4914f6cdd1dULL;
+  tlb->entries = (tlb_entry_t *)calloc(entries, sizeof(tlb_entry_t));
+  return tlb;
+}
+
+void tlb_destroy(tlb_t *tlb)
+{
+  free(tlb->entries);
+  free(tlb);
+}
+
+static tlb_entry_t *set_of(tlb_t *tlb, unsigned long long page)
+{
+  return &tlb->entries[(page % tlb->num_sets) * tlb->ways];
+}
+
+/* Returns the frame the current address space's page is cached with, or -1
+   on a miss. */
+long long tlb_lookup(tlb_t *tlb, unsigned long long page)
+{
+  tlb_entry_t *set = set_of(tlb, page);
+  unsigned int i;
+
+  for (i = 0; i < tlb->ways; i++)
+  {
+    if (set[i].valid && set[i].page == page && set[i].asid == tlb->asid)
+    {
+      set[i].last_use = ++tlb->clock;
+      return set[i].frame;
+    }
+  }
+  return -1;
+}
+
+/* Caches a translation for the current address space, evicting an entry of
+   its set if the set is full. The page must not be cached already. */
+void tlb_insert(tlb_t *tlb, unsigned long long page, unsigned int frame)
+{
+  tlb_entry_t *set = set_of(tlb, page), *victim = NULL;
+  unsigned int i;
+
+  for (i = 0; i < tlb->ways && victim == NULL; i++)
+    if (!set[i].valid)
+      victim = &set[i];
+
+  if (victim == NULL && tlb->policy == TLB_RANDOM)
+  {
+    /* xorshift64 */
+    tlb->random ^= tlb->random << 13;
+    tlb->random ^= tlb->random >> 7;
+    tlb->random ^= tlb->random << 17;
+    victim = &set[tlb->random % tlb->ways];
+  }
+  else if (victim == NULL)
+  {
+    victim = &set[0];
+    for (i = 1; i < tlb->ways; i++)
+      if (set[i].last_use < victim->last_use)
+        victim = &set[i];
+  }
+
+  victim->page = page;
+  victim->frame = frame;
+  victim->asid = tlb->asid;
+  victim->valid = 1;
+  victim->last_use = ++tlb->clock;
+}
+
+/* Drops asid's entry for page, if it has one, as when the page is evicted. */
+void tlb_invalidate(tlb_t *tlb, unsigned int asid, unsigned long long page)
+{
+  tlb_entry_t *set = set_of(tlb, page);
+  unsigned int i;
+
+  for (i = 0; i < tlb->ways; i++)
+    if (set[i].valid && set[i].page == page && set[i].asid == asid)
+      set[i].valid = 0;
+}
+
+/* Drops every entry mapping page to frame, whatever its address space, as
+   when a page that several processes share is evicted. Every process maps
+   a shared page at the same page number, so only page's set is searched. */
+void tlb_shootdown(tlb_t *tlb, unsigned long long page, unsigned int frame)
+{
+  tlb_entry_t *set = set_of(tlb, page);
+  unsigned int i;
+
+  for (i = 0; i < tlb->ways; i++)
+    if (set[i].valid && set[i].page == page && set[i].frame == frame)
+      set[i].valid = 0;
+}
+
+/* Drops every entry of asid, as when its process exits. */
+void tlb_flush_asid(tlb_t *tlb, unsigned int asid)
+{
+  unsigned int i;
+
+  for (i = 0; i < tlb->num_sets * tlb->ways; i++)
+    if (tlb->entries[i].asid == asid)
+      tlb->entries[i].valid = 0;
+}
+
+/* Makes asid the current address space. Without tagging, this flushes the
+   TLB if the address space changes. */
+void tlb_switch(tlb_t *tlb, unsigned int asid)
+{
+  unsigned int i;
+
+  if (asid == tlb->asid)
+    return;
+  tlb->asid = asid;
+  if (tlb->tagged)
+    return;
+  for (i = 0; i < tlb->num_sets * tlb->ways; i++)
+    tlb->entries[i].valid = 0;
+  tlb->flushes++;
+}
+
+/* Number of times tlb_switch flushed the TLB. */
+long long tlb_flushes(const tlb_t *tlb)
+{
+  return tlb->flushes;
+}
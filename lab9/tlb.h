@@ -0,0 +1,34 @@
+#ifndef TLB_H
+#define TLB_H
+
+/* A set-associative TLB caching page -> frame translations. A page goes in
+   set page % (entries / ways); a TLB with as many ways as entries is fully
+   associative. Within a set the victim is the least recently used entry or
+   a random one.
+
+   Entries belong to the address space (ASID) that was current when they
+   were added. With ASID tagging, switching address spaces keeps them and a
+   lookup only matches the current ASID's entries; without it, a switch
+   flushes the whole TLB. */
+typedef enum
+{
+  TLB_LRU = 0,
+  TLB_RANDOM
+} tlb_policy_t;
+
+typedef struct tlb tlb_t;
+
+int         tlb_parse_policy(const char *name, tlb_policy_t *policy);
+const char *tlb_policy_name(tlb_policy_t policy);
+
+tlb_t    *tlb_create(unsigned int entries, unsigned int ways, tlb_policy_t policy, int tagged);
+void      tlb_destroy(tlb_t *tlb);
+long long tlb_lookup(tlb_t *tlb, unsigned long long page);
+void      tlb_insert(tlb_t *tlb, unsigned long long page, unsigned int frame);
+void      tlb_invalidate(tlb_t *tlb, unsigned int asid, unsigned long long page);
+void      tlb_shootdown(tlb_t *tlb, unsigned long long page, unsigned int frame);
+void      tlb_flush_asid(tlb_t *tlb, unsigned int asid);
+void      tlb_switch(tlb_t *tlb, unsigned int asid);
+long long tlb_flushes(const tlb_t *tlb);
+
+#endif
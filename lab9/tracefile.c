@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tracefile.h"
+
+#define MAXSTR 1000
+
+/* Input that cannot be mapped (a pipe) is read in chunks of this size. The
+   buffer has PAD zero bytes after the data so 16-byte loads near its end
+   stay inside it. */
+#define CHUNK (1 << 20)
+#define PAD 16
+
+struct trace
+{
+  int fd;
+  char *data;      /* the mapped file, or a buffer of what has been read */
+  size_t pos;      /* where parsing continues */
+  size_t size;     /* end of the data */
+  size_t limit;    /* end of the last complete line in the data */
+  size_t capacity; /* of the buffer, not counting PAD */
+  int mapped, eof, binary, tagged;
+};
+
+/* Reads more of an unmapped input, keeping what has not been parsed yet.
+   Returns 0 if there is nothing more to read. */
+static int fill(trace_t *t)
+{
+  ssize_t got;
+
+  if (t->eof)
+    return 0;
+
+  memmove(t->data, t->data + t->pos, t->size - t->pos);
+  t->size -= t->pos;
+  t->pos = 0;
+  if (t->capacity - t->size < CHUNK / 2)
+  {
+    t->capacity *= 2;
+    t->data = (char *)realloc(t->data, t->capacity + PAD);
+  }
+
+  got = read(t->fd, t->data + t->size, t->capacity - t->size);
+  if (got <= 0)
+    t->eof = 1;
+  else
+    t->size += got;
+  memset(t->data + t->size, 0, PAD);
+  return 1;
+}
+
+/* Text is only parsed up to the last newline until the input ends, so a
+   line is never cut in two by a read. */
+static void set_limit(trace_t *t)
+{
+  size_t i = t->size;
+
+  if (!t->eof)
+    while (i > t->pos && t->data[i - 1] != '\n')
+      i--;
+  t->limit = i;
+}
+
+/* Copies the next line, without its newline, into line. Returns 0 at the
+   end of the input. */
+static int next_line(trace_t *t, char *line)
+{
+  char *eol;
+  size_t length;
+
+  while ((eol = (char *)memchr(t->data + t->pos, '\n', t->size - t->pos)) == NULL && fill(t))
+    ;
+  if (eol == NULL && t->pos == t->size)
+    return 0;
+
+  length = (eol != NULL ? (size_t)(eol - t->data) : t->size) - t->pos;
+  memcpy(line, t->data + t->pos, length < MAXSTR ? length : MAXSTR - 1);
+  line[length < MAXSTR ? length : MAXSTR - 1] = '\0';
+  t->pos += length + (eol != NULL);
+  return 1;
+}
+
+/* Whether the first line after the header is tagged: a fork or exit, or
+   more than one word. */
+static int first_line_tagged(trace_t *t)
+{
+  const char *p, *eol;
+
+  for (;;)
+  {
+    p = t->data + t->pos;
+    while (p < t->data + t->size && (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t'))
+      p++;
+    eol = (const char *)memchr(p, '\n', t->data + t->size - p);
+    if (eol != NULL || !fill(t))
+      break;
+  }
+  if (eol == NULL)
+    eol = t->data + t->size;
+
+  if (eol - p >= 4 && (memcmp(p, "fork", 4) == 0 || memcmp(p, "exit", 4) == 0))
+    return 1;
+  while (p < eol && *p != ' ' && *p != '\t' && *p != '\r')
+    p++;
+  while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  return p < eol;
+}
+
+/* Opens the trace on fd and reads its header. A regular file is mapped;
+   anything else is read as it is parsed. Returns NULL, after printing why,
+   if the header is not one VM_addr_map understands. */
+trace_t *trace_open(int fd, trace_header_t *header)
+{
+  trace_t *t = (trace_t *)calloc(1, sizeof(trace_t));
+  char line[MAXSTR];
+  unsigned int d;
+  struct stat st;
+
+  t->fd = fd;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    t->data = (char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (t->data != MAP_FAILED)
+    {
+      t->mapped = t->eof = 1;
+      t->size = st.st_size;
+      madvise(t->data, t->size, MADV_SEQUENTIAL);
+    }
+  }
+  if (!t->mapped)
+  {
+    t->capacity = CHUNK;
+    t->data = (char *)malloc(t->capacity + PAD);
+    while (t->size < sizeof(trace_header_t) && fill(t))
+      ;
+  }
+
+  if (t->size >= sizeof(trace_header_t) && memcmp(t->data, TRACE_MAGIC, 8) == 0)
+  {
+    memcpy(header, t->data, sizeof(trace_header_t));
+    t->pos = sizeof(trace_header_t);
+    t->binary = 1;
+    t->tagged = (header->flags & TRACE_TAGGED) != 0;
+    return t;
+  }
+
+  memcpy(header->magic, TRACE_MAGIC, 8);
+  header->flags = 0;
+  if (!next_line(t, line) || sscanf(line, "Logical address space size: %u^%u", &d, &header->log_size) != 2)
+  {
+    fprintf(stderr, "Unexpected line 1. Abort.\n");
+    trace_close(t);
+    return NULL;
+  }
+  if (!next_line(t, line) || sscanf(line, "Physical address space size: %u^%u", &d, &header->phy_size) != 2)
+  {
+    fprintf(stderr, "Unexpected line 2. Abort.\n");
+    trace_close(t);
+    return NULL;
+  }
+  if (!next_line(t, line) || sscanf(line, "Page size: %u^%u", &d, &header->page_size) != 2)
+  {
+    fprintf(stderr, "Unexpected line 3. Abort.\n");
+    trace_close(t);
+    return NULL;
+  }
+  t->tagged = first_line_tagged(t);
+  if (t->tagged)
+    header->flags |= TRACE_TAGGED;
+  set_limit(t);
+  return t;
+}
+
+void trace_close(trace_t *t)
+{
+  if (t->mapped)
+    munmap(t->data, t->size);
+  else
+    free(t->data);
+  free(t);
+}
+
+#ifdef __SSE2__
+/* Folds 8 nibbles, one per byte with the most significant first, into a
+   32-bit value */
+static unsigned long long fold_nibbles(unsigned long long x)
+{
+  x = ((x << 4) | (x >> 8)) & 0x00FF00FF00FF00FFULL;
+  x = ((x << 8) | (x >> 16)) & 0x0000FFFF0000FFFFULL;
+  return ((x << 16) | (x >> 32)) & 0x00000000FFFFFFFFULL;
+}
+
+/* The first 16 - n bytes from keep + n are 0xff and the rest are 0 */
+static const unsigned char keep[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+#endif
+
+/* Parses the hex digits at *p, up to limit, and leaves *p after them. Sets
+   *digits to how many there were. safe_end is how far 16-byte loads may
+   read. */
+static unsigned long long parse_hex(const char **p, const char *limit, const char *safe_end, int *digits)
+{
+  const char *s = *p;
+  unsigned long long value = 0;
+  int n = 0;
+
+#ifdef __SSE2__
+  /* Classify 16 characters at once; the run of hex digits at the start is
+     converted to nibbles, folded 8 at a time, and shifted down by the
+     digits it is short of 16. Runs of 16 or more are left to the loop. */
+  if (safe_end - s >= 16)
+  {
+    __m128i c = _mm_loadu_si128((const __m128i *)s);
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i alpha =
+        _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    int length = __builtin_ctz(~(unsigned int)_mm_movemask_epi8(_mm_or_si128(digit, alpha)));
+
+    if (length == 0 || s + length > limit)
+    {
+      *digits = 0;
+      return 0;
+    }
+    if (length < 16)
+    {
+      __m128i letter = _mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(0x40)), _mm_set1_epi8(0x40));
+      __m128i nibbles = _mm_add_epi8(_mm_and_si128(c, _mm_set1_epi8(0x0f)), _mm_and_si128(letter, _mm_set1_epi8(9)));
+
+      nibbles = _mm_and_si128(nibbles, _mm_loadu_si128((const __m128i *)(keep + 16 - length)));
+      value = fold_nibbles((unsigned long long)_mm_cvtsi128_si64(nibbles)) << 32 |
+              fold_nibbles((unsigned long long)_mm_cvtsi128_si64(_mm_srli_si128(nibbles, 8)));
+      *p = s + length;
+      *digits = length;
+      return value >> (4 * (16 - length));
+    }
+  }
+#else
+  (void)safe_end;
+#endif
+
+  for (; s < limit; s++, n++)
+  {
+    unsigned int d = (unsigned char)*s - '0', x = ((unsigned char)*s | 0x20) - 'a';
+
+    if (d < 10)
+      value = value << 4 | d;
+    else if (x < 6)
+      value = value << 4 | (x + 10);
+    else
+      break;
+  }
+  *p = s;
+  *digits = n;
+  return value;
+}
+
+/* Parses the text lines between pos and limit into addrs, up to max of
+   them. A line holds an address with or without "0x"; lines without one
+   are skipped. */
+static long parse_lines(trace_t *t, unsigned long long *addrs, long max)
+{
+  const char *p = t->data + t->pos, *limit = t->data + t->limit;
+  const char *safe_end = t->data + t->size + (t->mapped ? 0 : PAD);
+  long n = 0;
+
+  while (n < max)
+  {
+    unsigned long long value;
+    int digits;
+
+    while (p < limit && (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t'))
+      p++;
+    if (p == limit)
+      break;
+    if (p[0] == '0' && p + 1 < limit && (p[1] | 0x20) == 'x')
+      p += 2;
+
+    value = parse_hex(&p, limit, safe_end, &digits);
+    if (digits > 0)
+      addrs[n++] = value;
+
+    if (p < limit && *p != '\n')
+    {
+      p = (const char *)memchr(p, '\n', limit - p);
+      if (p == NULL)
+        p = limit;
+    }
+  }
+
+  t->pos = p - t->data;
+  return n;
+}
+
+static const char *skip_blanks(const char *p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  return p;
+}
+
+static unsigned long long parse_decimal(const char **p, const char *end)
+{
+  const char *s = *p;
+  unsigned long long value = 0;
+
+  while (s < end && *s >= '0' && *s <= '9')
+    value = value * 10 + (*s++ - '0');
+  *p = s;
+  return value;
+}
+
+/* parse_lines for tagged traces (see tracefile.h) */
+static long parse_tagged_lines(trace_t *t, trace_record_t *records, long max)
+{
+  const char *p = t->data + t->pos, *limit = t->data + t->limit;
+  const char *safe_end = t->data + t->size + (t->mapped ? 0 : PAD);
+  long n = 0;
+
+  while (n < max)
+  {
+    trace_record_t *r = &records[n];
+    const char *eol, *word, *next;
+    int digits;
+
+    while (p < limit && (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t'))
+      p++;
+    if (p == limit)
+      break;
+    eol = (const char *)memchr(p, '\n', limit - p);
+    if (eol == NULL)
+      eol = limit;
+
+    if (eol - p >= 4 && memcmp(p, "fork", 4) == 0)
+    {
+      p = skip_blanks(p + 4, eol);
+      r->pid = (uint32_t)parse_decimal(&p, eol);
+      p = skip_blanks(p, eol);
+      r->addr = parse_decimal(&p, eol);
+      r->op = TRACE_FORK;
+      n++;
+    }
+    else if (eol - p >= 4 && memcmp(p, "exit", 4) == 0)
+    {
+      p = skip_blanks(p + 4, eol);
+      r->pid = (uint32_t)parse_decimal(&p, eol);
+      r->addr = 0;
+      r->op = TRACE_EXIT;
+      n++;
+    }
+    else
+    {
+      /* "<pid> <address> [r|w]", or a bare address */
+      for (word = p; p < eol && *p != ' ' && *p != '\t' && *p != '\r'; p++)
+        ;
+      next = skip_blanks(p, eol);
+      r->pid = 0;
+      r->op = TRACE_READ;
+      if (next < eol)
+      {
+        r->pid = (uint32_t)parse_decimal(&word, p);
+        word = next;
+      }
+      if (word[0] == '0' && word + 1 < eol && (word[1] | 0x20) == 'x')
+        word += 2;
+      r->addr = parse_hex(&word, eol, safe_end, &digits);
+      word = skip_blanks(word, eol);
+      if (word < eol && (*word | 0x20) == 'w')
+        r->op = TRACE_WRITE;
+      if (digits > 0)
+        n++;
+    }
+    p = eol;
+  }
+
+  t->pos = p - t->data;
+  return n;
+}
+
+/* Copies up to max fixed-size records of a binary trace into out. */
+static long read_binary(trace_t *t, void *out, size_t record_size, long max)
+{
+  long n = 0;
+
+  while (n < max)
+  {
+    size_t available = (t->size - t->pos) / record_size;
+
+    if (available == 0)
+    {
+      if (!fill(t))
+        break;
+      continue;
+    }
+    if (available > (size_t)(max - n))
+      available = max - n;
+    memcpy((char *)out + n * record_size, t->data + t->pos, available * record_size);
+    t->pos += available * record_size;
+    n += available;
+  }
+
+  return n;
+}
+
+/* Reads up to max addresses of an untagged trace. Returns how many were
+   read; 0 at the end of the trace. */
+long trace_read(trace_t *t, unsigned long long *addrs, long max)
+{
+  long n = 0;
+
+  if (t->binary)
+    return read_binary(t, addrs, sizeof(uint64_t), max);
+
+  while (n < max)
+  {
+    if (t->pos >= t->limit)
+    {
+      if (!fill(t))
+        break;
+      set_limit(t);
+      continue;
+    }
+    n += parse_lines(t, addrs + n, max - n);
+  }
+
+  return n;
+}
+
+/* Reads up to max records of any trace; the addresses of an untagged one
+   are reads by process 0. Returns how many were read; 0 at the end of the
+   trace. */
+long trace_read_records(trace_t *t, trace_record_t *records, long max)
+{
+  long n = 0, i;
+
+  if (!t->tagged)
+  {
+    unsigned long long addrs[512];
+
+    while (n < max)
+    {
+      long got = trace_read(t, addrs, max - n < 512 ? max - n : 512);
+
+      if (got == 0)
+        break;
+      for (i = 0; i < got; i++)
+      {
+        records[n + i].addr = addrs[i];
+        records[n + i].pid = 0;
+        records[n + i].op = TRACE_READ;
+      }
+      n += got;
+    }
+    return n;
+  }
+
+  if (t->binary)
+    return read_binary(t, records, sizeof(trace_record_t), max);
+
+  while (n < max)
+  {
+    if (t->pos >= t->limit)
+    {
+      if (!fill(t))
+        break;
+      set_limit(t);
+      continue;
+    }
+    n += parse_tagged_lines(t, records + n, max - n);
+  }
+
+  return n;
+}
+
+/* Writes the rest of the trace to file_name in the binary format. Returns
+   the number of addresses (or records) written, or -1 if the file cannot
+   be written. */
+long long trace_save(trace_t *t, const trace_header_t *header, const char *file_name)
+{
+  FILE *out = fopen(file_name, "wb");
+  unsigned long long addrs[4096];
+  trace_record_t records[4096];
+  long long total = 0;
+  long n;
+
+  if (out == NULL)
+    return -1;
+  fwrite(header, sizeof(trace_header_t), 1, out);
+  if (t->tagged)
+  {
+    while ((n = trace_read_records(t, records, 4096)) > 0)
+    {
+      fwrite(records, sizeof(trace_record_t), n, out);
+      total += n;
+    }
+  }
+  else
+  {
+    while ((n = trace_read(t, addrs, 4096)) > 0)
+    {
+      fwrite(addrs, sizeof(unsigned long long), n, out);
+      total += n;
+    }
+  }
+  if (fclose(out) != 0)
+    return -1;
+  return total;
+}
@@ -0,0 +1,48 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <stdint.h>
+
+/* An address trace is either text or binary. Text is the three header
+   lines ("Logical address space size: 2^N" and so on) followed by one hex
+   address per line. Binary starts with trace_header_t and is followed by
+   the addresses as uint64_t in native byte order, up to the end of the
+   file, so a writer does not need to know the count up front.
+
+   A tagged trace follows several processes. Its lines are
+
+     <pid> <address> [r|w]   a read (the default) or write by process pid
+     fork <parent> <child>   child starts as a copy of parent
+     exit <pid>              pid exits
+
+   with pids in decimal; a bare address is an access by process 0. A text
+   trace is tagged if its first line after the header is. A tagged binary
+   trace has TRACE_TAGGED in its flags and trace_record_t records. */
+#define TRACE_MAGIC "VMTRACE1"
+#define TRACE_TAGGED 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t log_size, phy_size, page_size; /* exponents of 2 */
+  uint32_t flags;
+} trace_header_t;
+
+enum { TRACE_READ = 0, TRACE_WRITE, TRACE_FORK, TRACE_EXIT };
+
+typedef struct
+{
+  uint64_t addr; /* the address, or the child's pid for TRACE_FORK */
+  uint32_t pid;
+  uint32_t op;
+} trace_record_t;
+
+typedef struct trace trace_t;
+
+trace_t *trace_open(int fd, trace_header_t *header);
+long     trace_read(trace_t *t, unsigned long long *addrs, long max);
+long     trace_read_records(trace_t *t, trace_record_t *records, long max);
+long long trace_save(trace_t *t, const trace_header_t *header, const char *file_name);
+void     trace_close(trace_t *t);
+
+#endif